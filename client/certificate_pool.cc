@@ -0,0 +1,158 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/certificate_pool.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/rtc_certificate_generator.h"
+#include "rtc_base/ssl_identity.h"
+#include "rtc_base/time_utils.h"
+
+namespace {
+
+// Certificates about to expire are dropped rather than handed out, so that
+// one doesn't expire during a call.
+const int64_t kMinRemainingLifetimeMs = 24 * 60 * 60 * 1000;
+
+const char kCertificateBegin[] = "-----BEGIN CERTIFICATE-----";
+
+bool UsableNow(const rtc::RTCCertificate& certificate) {
+  return !certificate.HasExpired(rtc::TimeUTCMillis() +
+                                 kMinRemainingLifetimeMs);
+}
+
+}  // namespace
+
+CertificatePool::CertificatePool(size_t size, const std::string& dir)
+    : size_(size), dir_(dir), generating_(0) {}
+
+CertificatePool::~CertificatePool() {
+  // Waits for the certificate being generated, if any.
+  if (generator_thread_)
+    generator_thread_->Stop();
+}
+
+void CertificatePool::Start() {
+  RTC_DCHECK(!generator_thread_);
+  size_t loaded = 0;
+  for (size_t i = 0; !dir_.empty() && i < size_; ++i) {
+    std::ifstream file(PathOf(i));
+    if (!file.is_open())
+      break;
+    std::stringstream pem;
+    pem << file.rdbuf();
+    std::string text = pem.str();
+    // The private key comes first, then the certificate.
+    size_t split = text.find(kCertificateBegin);
+    if (split == std::string::npos)
+      continue;
+    rtc::scoped_refptr<rtc::RTCCertificate> certificate =
+        rtc::RTCCertificate::FromPEM(rtc::RTCCertificatePEM(
+            text.substr(0, split), text.substr(split)));
+    if (!certificate || !UsableNow(*certificate))
+      continue;
+    webrtc::MutexLock lock(&lock_);
+    certificates_.push_back(std::move(certificate));
+    ++loaded;
+  }
+  RTC_LOG(LS_INFO) << "Loaded " << loaded << " saved DTLS certificates";
+
+  generator_thread_ = rtc::Thread::Create();
+  generator_thread_->SetName("certificate_generator", nullptr);
+  generator_thread_->Start();
+  Refill();
+}
+
+rtc::scoped_refptr<rtc::RTCCertificate> CertificatePool::Take() {
+  rtc::scoped_refptr<rtc::RTCCertificate> certificate;
+  {
+    webrtc::MutexLock lock(&lock_);
+    while (!certificates_.empty() && !certificate) {
+      certificate = std::move(certificates_.front());
+      certificates_.pop_front();
+      if (!UsableNow(*certificate))
+        certificate = nullptr;
+    }
+  }
+  if (!certificate)
+    RTC_LOG(LS_WARNING) << "No DTLS certificate ready in the pool";
+  Refill();
+  return certificate;
+}
+
+void CertificatePool::Save() {
+  if (dir_.empty())
+    return;
+  std::vector<rtc::scoped_refptr<rtc::RTCCertificate>> certificates;
+  {
+    webrtc::MutexLock lock(&lock_);
+    certificates.assign(certificates_.begin(), certificates_.end());
+  }
+
+  size_t saved = 0;
+  for (const auto& certificate : certificates) {
+    rtc::RTCCertificatePEM pem = certificate->ToPEM();
+    std::ofstream file(PathOf(saved),
+                       std::ofstream::out | std::ofstream::trunc);
+    if (!file.is_open()) {
+      RTC_LOG(LS_ERROR) << "Failed to open file: " << PathOf(saved);
+      break;
+    }
+    file << pem.private_key() << pem.certificate();
+    ++saved;
+  }
+  // Files beyond the ones written are from a run that saved more.
+  for (size_t i = saved; i < size_; ++i)
+    remove(PathOf(i).c_str());
+}
+
+void CertificatePool::Refill() {
+  if (!generator_thread_)
+    return;
+  size_t missing;
+  {
+    webrtc::MutexLock lock(&lock_);
+    size_t have = certificates_.size() + generating_;
+    missing = have < size_ ? size_ - have : 0;
+    generating_ += missing;
+  }
+  for (size_t i = 0; i < missing; ++i)
+    generator_thread_->PostTask([this] { Generate(); });
+}
+
+void CertificatePool::Generate() {
+  int64_t started_us = rtc::TimeMicros();
+  rtc::scoped_refptr<rtc::RTCCertificate> certificate =
+      rtc::RTCCertificateGenerator::GenerateCertificate(
+          rtc::KeyParams::ECDSA(rtc::EC_NIST_P256), absl::nullopt);
+  webrtc::MutexLock lock(&lock_);
+  --generating_;
+  if (!certificate) {
+    RTC_LOG(LS_ERROR) << "Failed to generate a DTLS certificate";
+    return;
+  }
+  RTC_LOG(LS_VERBOSE) << "Generated a DTLS certificate in "
+                      << rtc::TimeMicros() - started_us << " us";
+  certificates_.push_back(std::move(certificate));
+}
+
+std::string CertificatePool::PathOf(size_t index) const {
+  return dir_ + "/dtls_certificate_" + std::to_string(index) + ".pem";
+}
@@ -0,0 +1,66 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_CERTIFICATE_POOL_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_CERTIFICATE_POOL_H_
+
+#include <stddef.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "api/scoped_refptr.h"
+#include "rtc_base/rtc_certificate.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread.h"
+#include "rtc_base/thread_annotations.h"
+
+// DTLS certificates generated ahead of time, so that a new PeerConnection
+// doesn't generate its own key while the call is being set up.  A thread of
+// the pool's own keeps `size` ECDSA certificates ready; every connection
+// takes a certificate of its own out of the pool.
+//
+// With a directory, the certificates left over at Save() are written to it
+// and read back at Start() by the next run.
+class CertificatePool {
+ public:
+  CertificatePool(size_t size, const std::string& dir);
+  ~CertificatePool();
+
+  // Loads the saved certificates that haven't expired and starts generating
+  // the rest in the background.
+  void Start();
+
+  // Returns a certificate for a new PeerConnection, or null if none is
+  // ready, in which case the PeerConnection generates its own.  Can be
+  // called from any thread.
+  rtc::scoped_refptr<rtc::RTCCertificate> Take();
+
+  // Writes the certificates in the pool to the directory, if there is one.
+  void Save();
+
+ private:
+  // Queues generating certificates until the pool is full again.
+  void Refill();
+  void Generate();
+  std::string PathOf(size_t index) const;
+
+  const size_t size_;
+  const std::string dir_;
+  std::unique_ptr<rtc::Thread> generator_thread_;
+  webrtc::Mutex lock_;
+  std::deque<rtc::scoped_refptr<rtc::RTCCertificate>> certificates_
+      RTC_GUARDED_BY(lock_);
+  // Certificates being generated or queued to be.
+  size_t generating_ RTC_GUARDED_BY(lock_);
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_CERTIFICATE_POOL_H_
@@ -0,0 +1,135 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/clock_offset_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Samples the best one is picked from.
+constexpr size_t kWindowSize = 8;
+// Best samples the drift is fitted to.
+constexpr size_t kMaxAnchors = 32;
+// Time the anchors must span before their drift is trusted; over shorter
+// spans the noise in the offsets outweighs it.
+constexpr int64_t kMinDriftSpanUs = 60 * 1000 * 1000;
+// Crystal oscillators are off by less than this.
+constexpr double kMaxDrift = 500e-6;
+
+}  // namespace
+
+ClockOffsetEstimator::ClockOffsetEstimator() : drift_(0), samples_(0) {}
+
+ClockOffsetEstimator::~ClockOffsetEstimator() = default;
+
+bool ClockOffsetEstimator::AddSample(int64_t sent_us,
+                                     int64_t server_received_us,
+                                     int64_t server_sent_us,
+                                     int64_t received_us) {
+  int64_t rtt_us =
+      (received_us - sent_us) - (server_sent_us - server_received_us);
+  if (received_us < sent_us || server_sent_us < server_received_us ||
+      rtt_us < 0) {
+    return false;
+  }
+  int64_t offset_us =
+      ((server_received_us - sent_us) + (server_sent_us - received_us)) / 2;
+
+  webrtc::MutexLock lock(&lock_);
+  ++samples_;
+  window_.push_back({received_us, offset_us, rtt_us});
+  if (window_.size() > kWindowSize)
+    window_.pop_front();
+
+  const Sample* best = BestSample();
+  if (anchors_.empty() || best->local_us > anchors_.back().local_us) {
+    anchors_.push_back(*best);
+    if (anchors_.size() > kMaxAnchors)
+      anchors_.pop_front();
+    UpdateDrift();
+  }
+  return true;
+}
+
+bool ClockOffsetEstimator::ToServerTime(int64_t local_us,
+                                        int64_t* server_us,
+                                        int64_t* uncertainty_us) const {
+  webrtc::MutexLock lock(&lock_);
+  const Sample* best = BestSample();
+  if (!best)
+    return false;
+  int64_t elapsed_us = local_us - best->local_us;
+  *server_us = local_us + best->offset_us +
+               static_cast<int64_t>(drift_ * elapsed_us);
+  // The server answered somewhere within the round trip, and the drift
+  // estimate may be off by as much as it corrects.
+  if (uncertainty_us) {
+    *uncertainty_us = best->rtt_us / 2 +
+                      static_cast<int64_t>(std::abs(drift_ * elapsed_us));
+  }
+  return true;
+}
+
+int ClockOffsetEstimator::samples() const {
+  webrtc::MutexLock lock(&lock_);
+  return samples_;
+}
+
+double ClockOffsetEstimator::drift_ppm() const {
+  webrtc::MutexLock lock(&lock_);
+  return drift_ * 1e6;
+}
+
+void ClockOffsetEstimator::Reset() {
+  webrtc::MutexLock lock(&lock_);
+  window_.clear();
+  anchors_.clear();
+  drift_ = 0;
+  samples_ = 0;
+}
+
+const ClockOffsetEstimator::Sample* ClockOffsetEstimator::BestSample() const {
+  const Sample* best = nullptr;
+  for (const Sample& sample : window_) {
+    // Ties go to the newer sample, which needs less carrying forward.
+    if (!best || sample.rtt_us <= best->rtt_us)
+      best = &sample;
+  }
+  return best;
+}
+
+void ClockOffsetEstimator::UpdateDrift() {
+  if (anchors_.size() < 2 ||
+      anchors_.back().local_us - anchors_.front().local_us < kMinDriftSpanUs) {
+    drift_ = 0;
+    return;
+  }
+
+  // Least squares fit of the offset over local time, relative to the oldest
+  // anchor to keep the sums small.
+  const Sample& origin = anchors_.front();
+  double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+  for (const Sample& anchor : anchors_) {
+    double x = static_cast<double>(anchor.local_us - origin.local_us);
+    double y = static_cast<double>(anchor.offset_us - origin.offset_us);
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+  }
+  double n = static_cast<double>(anchors_.size());
+  double denominator = n * sum_xx - sum_x * sum_x;
+  if (denominator <= 0)
+    return;
+  drift_ = std::clamp((n * sum_xy - sum_x * sum_y) / denominator, -kMaxDrift,
+                      kMaxDrift);
+}
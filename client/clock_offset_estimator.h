@@ -0,0 +1,77 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_CLOCK_OFFSET_ESTIMATOR_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_CLOCK_OFFSET_ESTIMATOR_H_
+
+#include <stdint.h>
+
+#include <deque>
+
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread_annotations.h"
+
+// Estimates how far the local clock (rtc::TimeMicros) is off the server's
+// wall clock, NTP style, from the times a request left and its answer came
+// back and the times the server received and answered it.  Clients that are
+// signed in to the same server share its clock as a time base.
+//
+// Of the last few samples the one with the shortest round trip gives the
+// offset, since it was held up the least on either way.  The offsets of
+// those best samples over the last minutes give the drift between the
+// clocks, which carries the offset forward between samples.
+//
+// Samples are added on the main thread; the estimate may be read from any
+// thread.
+class ClockOffsetEstimator {
+ public:
+  ClockOffsetEstimator();
+  ~ClockOffsetEstimator();
+
+  // Returns false if the timestamps are inconsistent and the sample is
+  // discarded.
+  bool AddSample(int64_t sent_us,
+                 int64_t server_received_us,
+                 int64_t server_sent_us,
+                 int64_t received_us);
+
+  // Converts a local time to the server's, in microseconds since the epoch.
+  // `uncertainty_us`, if given, is set to how far off the result may be.
+  // Returns false until there's a sample.
+  bool ToServerTime(int64_t local_us,
+                    int64_t* server_us,
+                    int64_t* uncertainty_us) const;
+
+  int samples() const;
+  // Server microseconds gained per local second, in parts per million.
+  double drift_ppm() const;
+
+  void Reset();
+
+ private:
+  struct Sample {
+    int64_t local_us;
+    // Server time minus local time.
+    int64_t offset_us;
+    int64_t rtt_us;
+  };
+
+  const Sample* BestSample() const RTC_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void UpdateDrift() RTC_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  mutable webrtc::Mutex lock_;
+  std::deque<Sample> window_ RTC_GUARDED_BY(lock_);
+  // The best sample of each window, oldest first.
+  std::deque<Sample> anchors_ RTC_GUARDED_BY(lock_);
+  double drift_ RTC_GUARDED_BY(lock_);
+  int samples_ RTC_GUARDED_BY(lock_);
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_CLOCK_OFFSET_ESTIMATOR_H_
@@ -33,6 +33,7 @@
 #include "api/rtp_sender_interface.h"
 #include "api/stats/rtcstats_objects.h"
 #include "api/stats/rtc_stats_report.h"
+#include "api/task_queue/default_task_queue_factory.h"
 #include "api/video_codecs/video_decoder_factory.h"
 #include "api/video_codecs/video_decoder_factory_template.h"
 #include "api/video_codecs/video_decoder_factory_template_dav1d_adapter.h"
@@ -46,6 +47,11 @@
 #include "api/video_codecs/video_encoder_factory_template_libvpx_vp9_adapter.h"
 #include "api/video_codecs/video_encoder_factory_template_open_h264_adapter.h"
 #include "examples/headless_peerconnection/client/defaults.h"
+#include "examples/headless_peerconnection/client/fake_audio_device.h"
+#include "examples/headless_peerconnection/client/file_video_source.h"
+#include "examples/headless_peerconnection/client/generated_video_source.h"
+#include "examples/headless_peerconnection/client/ivf_passthrough_encoder.h"
+#include "examples/headless_peerconnection/client/signaling_codec.h"
 #include "modules/audio_device/include/audio_device.h"
 #include "modules/audio_processing/include/audio_processing.h"
 #include "modules/video_capture/video_capture.h"
@@ -56,25 +62,31 @@
 #include "rtc_base/logging.h"
 #include "rtc_base/ref_counted_object.h"
 #include "rtc_base/rtc_certificate_generator.h"
-#include "rtc_base/strings/json.h"
+#include "rtc_base/time_utils.h"
 #include "test/vcm_capturer.h"
 
 
 
 namespace {
-// Names used for a IceCandidate JSON object.
-const char kCandidateSdpMidName[] = "sdpMid";
-const char kCandidateSdpMlineIndexName[] = "sdpMLineIndex";
-const char kCandidateSdpName[] = "candidate";
 
-// Names used for a SessionDescription JSON object.
-const char kSessionDescriptionTypeName[] = "type";
-const char kSessionDescriptionSdpName[] = "sdp";
+// The current time in the time base shared with the other clients signed in
+// to the server, for lining up their logs and stats, or the local time until
+// the offset to the server's clock is known.
+std::string SharedTimestamp(const ClockOffsetEstimator& clock) {
+  int64_t local_us = rtc::TimeMicros();
+  int64_t server_us = 0;
+  int64_t uncertainty_us = 0;
+  if (!clock.ToServerTime(local_us, &server_us, &uncertainty_us))
+    return "local_time_us=" + std::to_string(local_us);
+  return "shared_time_us=" + std::to_string(server_us) + " +-" +
+         std::to_string(uncertainty_us);
+}
 
 class MyStatsObserver : public webrtc::StatsObserver {
 public:
 
-    MyStatsObserver(): ref_count_(0) {}
+    MyStatsObserver(const ClockOffsetEstimator* clock, int peer_id)
+        : clock_(clock), peer_id_(peer_id), ref_count_(0) {}
 
     void AddRef() const override {
       ref_count_.fetch_add(1, std::memory_order_relaxed);
@@ -98,6 +110,8 @@ public:
             return;
         }
 
+        logfile << SharedTimestamp(*clock_) << " peer_id=" << peer_id_
+                << std::endl;
         // Process the stats here.
         for (const webrtc::StatsReport* report : reports) {
             // Example: Print the stats to standard output.
@@ -135,11 +149,16 @@ public:
     }
 
 private:
+    const ClockOffsetEstimator* const clock_;
+    const int peer_id_;
     mutable std::atomic<int> ref_count_;
 };
 
 class StatsLoggerCallback : public webrtc::RTCStatsCollectorCallback {
  public:
+  StatsLoggerCallback(const ClockOffsetEstimator* clock, int peer_id)
+      : clock_(clock), peer_id_(peer_id) {}
+
   void OnStatsDelivered(
       const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report) override {
 
@@ -148,7 +167,10 @@ class StatsLoggerCallback : public webrtc::RTCStatsCollectorCallback {
         RTC_LOG(LS_ERROR) << "Failed to open file: output_stats.txt";
         return;
     }
-    logfile << std::to_string(report->timestamp().ms<double>()) << " --- Stats Report: " << "\n" << std::endl;
+    logfile << std::to_string(report->timestamp().ms<double>())
+            << " --- Stats Report: " << SharedTimestamp(*clock_)
+            << " peer_id=" << peer_id_ << "\n"
+            << std::endl;
     for (const auto& stats : *report) {
       logfile << "- Stats for " << stats.type() << ": " << stats.id() << "\n" << std::endl;
       for (const auto& attribute : stats.Attributes()) {
@@ -159,19 +181,10 @@ class StatsLoggerCallback : public webrtc::RTCStatsCollectorCallback {
     }
     //logfile << "-----------------------------";
   }
-};
 
-class DummySetSessionDescriptionObserver
-    : public webrtc::SetSessionDescriptionObserver {
- public:
-  static rtc::scoped_refptr<DummySetSessionDescriptionObserver> Create() {
-    return rtc::make_ref_counted<DummySetSessionDescriptionObserver>();
-  }
-  virtual void OnSuccess() { RTC_LOG(LS_INFO) << __FUNCTION__; }
-  virtual void OnFailure(webrtc::RTCError error) {
-    RTC_LOG(LS_INFO) << __FUNCTION__ << " " << ToString(error.type()) << ": "
-                     << error.message();
-  }
+ private:
+  const ClockOffsetEstimator* const clock_;
+  const int peer_id_;
 };
 
 class CapturerTrackSource : public webrtc::VideoTrackSource {
@@ -213,8 +226,19 @@ class CapturerTrackSource : public webrtc::VideoTrackSource {
 }  // namespace
 
 Conductor::Conductor(PeerConnectionClient* client, MainWindow* main_wnd)
-    : peer_id_(-1), loopback_(false), client_(client), main_wnd_(main_wnd), stats_thread_(nullptr), legacy_stats_thread_(nullptr), continue_collecting_stats_(true) {
+    : client_(client),
+      main_wnd_(main_wnd),
+      max_sessions_(1),
+      last_sent_peer_id_(-1),
+      rendered_peer_id_(-1),
+      prewarm_pool_size_(0),
+      stats_thread_(nullptr),
+      legacy_stats_thread_(nullptr),
+      continue_collecting_stats_(true),
+      calls_traced_(0) {
   client_->RegisterObserver(this);
+  client_->set_timeline(&timeline_);
+  timeline_.set_clock(&client_->clock_offset());
   main_wnd->RegisterObserver(this);
 
   // Create new output_stats.txt file
@@ -242,24 +266,32 @@ Conductor::Conductor(PeerConnectionClient* client, MainWindow* main_wnd)
 }
 
 bool Conductor::connection_active() const {
-  return peer_connection_ != nullptr;
+  return !sessions_.empty();
 }
 
 void Conductor::Close() {
   client_->SignOut();
-  DeletePeerConnection();
+  DeleteAllSessions();
+  DeleteStandbySession();
+  if (certificate_pool_)
+    certificate_pool_->Save();
+  peer_connection_factory_ = nullptr;
 }
 
 void Conductor::LogStats() {
-  if (!peer_connection_) {
+  auto peer_connections = GetPeerConnections();
+  if (peer_connections.empty()) {
     RTC_LOG(LS_ERROR) << "PeerConnection is not initialized.";
     return;
   }
 
   // Create a stats collector callback and pass it to GetStats
-  rtc::scoped_refptr<StatsLoggerCallback> callback =
-      rtc::make_ref_counted<StatsLoggerCallback>();
-  peer_connection_->GetStats(callback.get());
+  for (const auto& peer_connection : peer_connections) {
+    rtc::scoped_refptr<StatsLoggerCallback> callback =
+        rtc::make_ref_counted<StatsLoggerCallback>(&client_->clock_offset(),
+                                                   peer_connection.first);
+    peer_connection.second->GetStats(callback.get());
+  }
 }
 
 void Conductor::RepeatedlyCallGetStatsWrapper(Conductor* conductor) {
@@ -277,9 +309,12 @@ void Conductor::RepeatedlyStartStatsLogging(Conductor* conductor) {
 void Conductor::RepeatedlyCallStats() {
   RTC_LOG(LS_INFO) << "Called the function StartStatsThread!!!\n";
   while (continue_collecting_stats_) {
-    if (peer_connection_.get()) {
-        MyStatsObserver* stats_observer = new MyStatsObserver();
-        peer_connection_->GetStats(stats_observer, nullptr, webrtc::PeerConnectionInterface::kStatsOutputLevelStandard);
+    for (const auto& peer_connection : GetPeerConnections()) {
+      MyStatsObserver* stats_observer = new MyStatsObserver(
+          &client_->clock_offset(), peer_connection.first);
+      peer_connection.second->GetStats(
+          stats_observer, nullptr,
+          webrtc::PeerConnectionInterface::kStatsOutputLevelStandard);
     }
 
     rtc::Thread::SleepMs(100);
@@ -289,7 +324,7 @@ void Conductor::RepeatedlyCallStats() {
 void Conductor::StartStatsLogging() {
   rtc::Thread::Current()->PostDelayedTask(
       [this]() {
-        if (peer_connection_) {
+        if (!GetPeerConnections().empty()) {
           LogStats();
           StartStatsLogging();  // Schedule the next call
         }
@@ -322,29 +357,53 @@ void Conductor::StopStatsThread() {
 }
 
 Conductor::~Conductor() {
-  RTC_DCHECK(!peer_connection_);
+  RTC_DCHECK(sessions_.empty());
+  RTC_DCHECK(!standby_session_);
   StopLegacyStatsThread();
   StopStatsThread();
 }
 
-bool Conductor::InitializePeerConnection() {
-  RTC_DCHECK(!peer_connection_factory_);
-  RTC_DCHECK(!peer_connection_);
-
-  if (!signaling_thread_.get()) {
-    signaling_thread_ = rtc::Thread::CreateWithSocketServer();
-    signaling_thread_->Start();
+bool Conductor::InitializePeerConnectionFactory() {
+  if (peer_connection_factory_)
+    return true;
+  int64_t started_us = rtc::TimeMicros();
+
+  if (!network_thread_)
+    StartThread(&network_thread_, "pc_network", true, network_placement_);
+  if (!worker_thread_)
+    StartThread(&worker_thread_, "pc_worker", false, worker_placement_);
+  if (!signaling_thread_)
+    StartThread(&signaling_thread_, "pc_signaling", true, signaling_placement_);
+  std::unique_ptr<webrtc::VideoEncoderFactory> video_encoder_factory;
+  if (passthrough_video_) {
+    video_encoder_factory =
+        std::make_unique<IvfEncoderFactory>(passthrough_video_);
+  } else {
+    video_encoder_factory =
+        std::make_unique<webrtc::VideoEncoderFactoryTemplate<
+            webrtc::LibvpxVp8EncoderTemplateAdapter,
+            webrtc::LibvpxVp9EncoderTemplateAdapter,
+            webrtc::OpenH264EncoderTemplateAdapter,
+            webrtc::LibaomAv1EncoderTemplateAdapter>>();
+  }
+  rtc::scoped_refptr<webrtc::AudioDeviceModule> audio_device;
+  if (fake_audio_.enabled()) {
+    if (!task_queue_factory_)
+      task_queue_factory_ = webrtc::CreateDefaultTaskQueueFactory();
+    audio_device =
+        CreateFakeAudioDevice(task_queue_factory_.get(), fake_audio_);
+    if (!audio_device) {
+      main_wnd_->MessageBox("Error", "Failed to create the fake audio device",
+                            true);
+      return false;
+    }
   }
   peer_connection_factory_ = webrtc::CreatePeerConnectionFactory(
-      nullptr /* network_thread */, nullptr /* worker_thread */,
-      signaling_thread_.get(), nullptr /* default_adm */,
+      network_thread_.get(), worker_thread_.get(), signaling_thread_.get(),
+      audio_device /* null for the platform's */,
       webrtc::CreateBuiltinAudioEncoderFactory(),
       webrtc::CreateBuiltinAudioDecoderFactory(),
-      std::make_unique<webrtc::VideoEncoderFactoryTemplate<
-          webrtc::LibvpxVp8EncoderTemplateAdapter,
-          webrtc::LibvpxVp9EncoderTemplateAdapter,
-          webrtc::OpenH264EncoderTemplateAdapter,
-          webrtc::LibaomAv1EncoderTemplateAdapter>>(),
+      std::move(video_encoder_factory),
       std::make_unique<webrtc::VideoDecoderFactoryTemplate<
           webrtc::LibvpxVp8DecoderTemplateAdapter,
           webrtc::LibvpxVp9DecoderTemplateAdapter,
@@ -355,72 +414,182 @@ bool Conductor::InitializePeerConnection() {
   if (!peer_connection_factory_) {
     main_wnd_->MessageBox("Error", "Failed to initialize PeerConnectionFactory",
                           true);
-    DeletePeerConnection();
     return false;
   }
 
-  if (!CreatePeerConnection()) {
-    main_wnd_->MessageBox("Error", "CreatePeerConnection failed", true);
-    DeletePeerConnection();
+  // The codec factories are only asked for their formats once something
+  // needs them, so ask now rather than during the first offer.
+  peer_connection_factory_->GetRtpSenderCapabilities(
+      cricket::MEDIA_TYPE_AUDIO);
+  peer_connection_factory_->GetRtpSenderCapabilities(
+      cricket::MEDIA_TYPE_VIDEO);
+  RTC_LOG(LS_INFO) << "PeerConnectionFactory created in "
+                   << rtc::TimeMicros() - started_us << " us";
+  return true;
+}
+
+void Conductor::StartThread(std::unique_ptr<rtc::Thread>* thread,
+                            const char* name,
+                            bool with_sockets,
+                            const ThreadPlacement& placement) {
+  *thread = with_sockets ? rtc::Thread::CreateWithSocketServer()
+                         : rtc::Thread::Create();
+  (*thread)->SetName(name, nullptr);
+  (*thread)->Start();
+  (*thread)->BlockingCall([name, &placement] {
+    PlaceCurrentThread(name, placement);
+  });
+}
+
+PeerSession* Conductor::CreateSession(int peer_id) {
+  RTC_DCHECK(sessions_.find(peer_id) == sessions_.end());
+  int64_t started_us = rtc::TimeMicros();
+
+  timeline_.BeginCall(peer_id);
+  if (!InitializePeerConnectionFactory()) {
+    timeline_.EndCall(client_->id(), peer_id, "");
+    return nullptr;
+  }
+  if (local_tracks_.empty())
+    CreateLocalTracks();
+
+  rtc::scoped_refptr<PeerSession> session;
+  std::string detail;
+  if (standby_session_) {
+    session = std::move(standby_session_);
+    session->AssignPeer(peer_id);
+    detail = ", prewarmed";
+    // The replacement is warmed once this call's offer or answer is under
+    // way.
+    main_wnd_->QueueUIThreadCallback(WARM_STANDBY_SESSION, NULL);
+  } else {
+    session = rtc::make_ref_counted<PeerSession>(peer_id, this, &timeline_);
+    if (!session->Initialize(peer_connection_factory_, local_tracks_,
+                             prewarm_pool_size_, TakeCertificate())) {
+      main_wnd_->MessageBox("Error", "CreatePeerConnection failed", true);
+      session->Close(client_->id(), "");
+      if (sessions_.empty() && !standby_session_) {
+        main_wnd_->StopLocalRenderer();
+        local_tracks_.clear();
+      }
+      return nullptr;
+    }
+  }
+  {
+    webrtc::MutexLock lock(&sessions_lock_);
+    sessions_[peer_id] = session;
+  }
+
+  timeline_.Mark(peer_id, SignalingTimeline::kSignaling,
+                 "peer_connection_initialized",
+                 std::to_string(rtc::TimeMicros() - started_us) + " us" +
+                     detail);
+  EnsureStreamingUI();
+  return session.get();
+}
+
+void Conductor::DeleteSession(int peer_id) {
+  auto it = sessions_.find(peer_id);
+  if (it == sessions_.end())
+    return;
+  rtc::scoped_refptr<PeerSession> session = it->second;
+  {
+    webrtc::MutexLock lock(&sessions_lock_);
+    sessions_.erase(it);
+  }
+
+  std::string path;
+  if (!signaling_trace_dir_.empty() && timeline_.in_call(peer_id)) {
+    path = signaling_trace_dir_ + "/signaling_trace_" +
+           std::to_string(client_->id()) + "_" + std::to_string(peer_id) +
+           "_" + std::to_string(++calls_traced_) + ".json";
   }
+  session->Close(client_->id(), path);
 
-  AddTracks();
+  if (rendered_peer_id_ == peer_id) {
+    main_wnd_->StopRemoteRenderer();
+    rendered_peer_id_ = -1;
+  }
+  // The local tracks, and with them the capturer, are let go of with the
+  // last session, unless a standby session holds on to them.  The factory is
+  // kept for the next call.
+  if (sessions_.empty() && !standby_session_) {
+    main_wnd_->StopLocalRenderer();
+    local_tracks_.clear();
+  }
+}
 
-  return peer_connection_ != nullptr;
+void Conductor::DeleteAllSessions() {
+  while (!sessions_.empty())
+    DeleteSession(sessions_.begin()->first);
 }
 
-bool Conductor::ReinitializePeerConnectionForLoopback() {
-  loopback_ = true;
-  std::vector<rtc::scoped_refptr<webrtc::RtpSenderInterface>> senders =
-      peer_connection_->GetSenders();
-  peer_connection_ = nullptr;
-  // Loopback is only possible if encryption is disabled.
-  webrtc::PeerConnectionFactoryInterface::Options options;
-  options.disable_encryption = true;
-  peer_connection_factory_->SetOptions(options);
-  if (CreatePeerConnection()) {
-    for (const auto& sender : senders) {
-      peer_connection_->AddTrack(sender->track(), sender->stream_ids());
+void Conductor::WarmStandbySession() {
+  if (prewarm_pool_size_ <= 0 || standby_session_ || !client_->is_connected())
+    return;
+  int64_t started_us = rtc::TimeMicros();
+  if (!InitializePeerConnectionFactory())
+    return;
+  if (local_tracks_.empty())
+    CreateLocalTracks();
+
+  auto session = rtc::make_ref_counted<PeerSession>(-1, this, &timeline_);
+  if (!session->Initialize(peer_connection_factory_, local_tracks_,
+                           prewarm_pool_size_, TakeCertificate())) {
+    RTC_LOG(LS_ERROR) << "Failed to create the standby PeerConnection";
+    session->Close(client_->id(), "");
+    if (sessions_.empty()) {
+      main_wnd_->StopLocalRenderer();
+      local_tracks_.clear();
     }
-    peer_connection_->CreateOffer(
-        this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+    return;
+  }
+  standby_session_ = session;
+  RTC_LOG(LS_INFO) << "Standby PeerConnection created in "
+                   << rtc::TimeMicros() - started_us << " us";
+}
+
+void Conductor::DeleteStandbySession() {
+  if (!standby_session_)
+    return;
+  standby_session_->Close(client_->id(), "");
+  standby_session_ = nullptr;
+  if (sessions_.empty()) {
+    main_wnd_->StopLocalRenderer();
+    local_tracks_.clear();
   }
-  options.disable_encryption = false;
-  peer_connection_factory_->SetOptions(options);
-  return peer_connection_ != nullptr;
 }
 
-bool Conductor::CreatePeerConnection() {
-  RTC_DCHECK(peer_connection_factory_);
-  RTC_DCHECK(!peer_connection_);
+void Conductor::EnableCertificatePool(size_t size, const std::string& dir) {
+  RTC_DCHECK(!certificate_pool_);
+  certificate_pool_ = std::make_unique<CertificatePool>(size, dir);
+  certificate_pool_->Start();
+}
 
-  webrtc::PeerConnectionInterface::RTCConfiguration config;
-  config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
-  webrtc::PeerConnectionInterface::IceServer server;
-  server.uri = GetPeerConnectionString();
-  config.servers.push_back(server);
+rtc::scoped_refptr<rtc::RTCCertificate> Conductor::TakeCertificate() {
+  if (!certificate_pool_)
+    return nullptr;
+  return certificate_pool_->Take();
+}
 
-  webrtc::PeerConnectionDependencies pc_dependencies(this);
-  auto error_or_peer_connection =
-      peer_connection_factory_->CreatePeerConnectionOrError(
-          config, std::move(pc_dependencies));
-  if (error_or_peer_connection.ok()) {
-    peer_connection_ = std::move(error_or_peer_connection.value());
-  }
-  return peer_connection_ != nullptr;
+bool Conductor::at_session_limit() const {
+  return max_sessions_ > 0 &&
+         sessions_.size() >= static_cast<size_t>(max_sessions_);
 }
 
-void Conductor::DeletePeerConnection() {
-  main_wnd_->StopLocalRenderer();
-  main_wnd_->StopRemoteRenderer();
-  peer_connection_ = nullptr;
-  peer_connection_factory_ = nullptr;
-  peer_id_ = -1;
-  loopback_ = false;
+std::map<int, rtc::scoped_refptr<webrtc::PeerConnectionInterface>>
+Conductor::GetPeerConnections() const {
+  webrtc::MutexLock lock(&sessions_lock_);
+  std::map<int, rtc::scoped_refptr<webrtc::PeerConnectionInterface>>
+      peer_connections;
+  for (const auto& session : sessions_) {
+    if (session.second->peer_connection())
+      peer_connections[session.first] = session.second->peer_connection();
+  }
+  return peer_connections;
 }
 
 void Conductor::EnsureStreamingUI() {
-  RTC_DCHECK(peer_connection_);
   if (main_wnd_->IsWindow()) {
     if (main_wnd_->current_ui() != MainWindow::STREAMING)
       main_wnd_->SwitchToStreamingUI();
@@ -428,48 +597,27 @@ void Conductor::EnsureStreamingUI() {
 }
 
 //
-// PeerConnectionObserver implementation.
+// PeerSessionObserver implementation.
 //
 
-void Conductor::OnAddTrack(
-    rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
-    const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>&
-        streams) {
-  RTC_LOG(LS_INFO) << __FUNCTION__ << " " << receiver->id();
-  main_wnd_->QueueUIThreadCallback(NEW_TRACK_ADDED,
-                                   receiver->track().release());
+void Conductor::OnSessionMessage(int peer_id, std::string message) {
+  main_wnd_->QueueUIThreadCallback(
+      SEND_MESSAGE_TO_PEER,
+      new PeerEvent{peer_id, std::move(message), nullptr});
 }
 
-void Conductor::OnRemoveTrack(
-    rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) {
-  RTC_LOG(LS_INFO) << __FUNCTION__ << " " << receiver->id();
-  main_wnd_->QueueUIThreadCallback(TRACK_REMOVED, receiver->track().release());
+void Conductor::OnSessionTrackAdded(
+    int peer_id,
+    rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track) {
+  main_wnd_->QueueUIThreadCallback(
+      NEW_TRACK_ADDED, new PeerEvent{peer_id, std::string(), std::move(track)});
 }
 
-void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate) {
-  RTC_LOG(LS_INFO) << __FUNCTION__ << " " << candidate->sdp_mline_index();
-  // For loopback test. To save some connecting delay.
-  if (loopback_) {
-    if (!peer_connection_->AddIceCandidate(candidate)) {
-      RTC_LOG(LS_WARNING) << "Failed to apply the received candidate";
-    }
-    return;
-  }
-
-  Json::Value jmessage;
-  jmessage[kCandidateSdpMidName] = candidate->sdp_mid();
-  jmessage[kCandidateSdpMlineIndexName] = candidate->sdp_mline_index();
-  std::string sdp;
-  if (!candidate->ToString(&sdp)) {
-    RTC_LOG(LS_ERROR) << "Failed to serialize candidate";
-    return;
-  }
-  jmessage[kCandidateSdpName] = sdp;
-
-  Json::StreamWriterBuilder factory;
-  SendMessage(Json::writeString(factory, jmessage));
-
-  LogStats();
+void Conductor::OnSessionTrackRemoved(
+    int peer_id,
+    rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track) {
+  main_wnd_->QueueUIThreadCallback(
+      TRACK_REMOVED, new PeerEvent{peer_id, std::string(), std::move(track)});
 }
 
 //
@@ -479,12 +627,14 @@ void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate) {
 void Conductor::OnSignedIn() {
   RTC_LOG(LS_INFO) << __FUNCTION__;
   main_wnd_->SwitchToPeerList(client_->peers());
+  WarmStandbySession();
 }
 
 void Conductor::OnDisconnected() {
   RTC_LOG(LS_INFO) << __FUNCTION__;
 
-  DeletePeerConnection();
+  DeleteAllSessions();
+  DeleteStandbySession();
 
   if (main_wnd_->IsWindow())
     main_wnd_->SwitchToConnectUI();
@@ -492,6 +642,7 @@ void Conductor::OnDisconnected() {
 
 void Conductor::OnPeerConnected(int id, const std::string& name) {
   RTC_LOG(LS_INFO) << __FUNCTION__;
+  timeline_.MarkPeerDiscovered(id);
   // Refresh the list if we're showing it.
   if (main_wnd_->current_ui() == MainWindow::LIST_PEERS)
     main_wnd_->SwitchToPeerList(client_->peers());
@@ -499,9 +650,11 @@ void Conductor::OnPeerConnected(int id, const std::string& name) {
 
 void Conductor::OnPeerDisconnected(int id) {
   RTC_LOG(LS_INFO) << __FUNCTION__;
-  if (id == peer_id_) {
+  timeline_.ForgetPeer(id);
+  if (sessions_.find(id) != sessions_.end()) {
     RTC_LOG(LS_INFO) << "Our peer disconnected";
-    main_wnd_->QueueUIThreadCallback(PEER_CONNECTION_CLOSED, NULL);
+    main_wnd_->QueueUIThreadCallback(PEER_CONNECTION_CLOSED,
+                                     new PeerEvent{id, std::string(), nullptr});
   } else {
     // Refresh the list if we're showing it.
     if (main_wnd_->current_ui() == MainWindow::LIST_PEERS)
@@ -510,124 +663,47 @@ void Conductor::OnPeerDisconnected(int id) {
 }
 
 void Conductor::OnMessageFromPeer(int peer_id, const std::string& message) {
-  RTC_DCHECK(peer_id_ == peer_id || peer_id_ == -1);
   RTC_DCHECK(!message.empty());
 
-  if (!peer_connection_.get()) {
-    RTC_DCHECK(peer_id_ == -1);
-    peer_id_ = peer_id;
-
-    if (!InitializePeerConnection()) {
+  auto it = sessions_.find(peer_id);
+  PeerSession* session;
+  if (it != sessions_.end()) {
+    session = it->second.get();
+  } else if (at_session_limit()) {
+    RTC_LOG(LS_WARNING)
+        << "Received a message from unknown peer while already in "
+        << sessions_.size() << " conversations with different peers.";
+    return;
+  } else {
+    session = CreateSession(peer_id);
+    if (!session) {
       RTC_LOG(LS_ERROR) << "Failed to initialize our PeerConnection instance";
       client_->SignOut();
       return;
     }
-  } else if (peer_id != peer_id_) {
-    RTC_DCHECK(peer_id_ != -1);
-    RTC_LOG(LS_WARNING)
-        << "Received a message from unknown peer while already in a "
-           "conversation with a different peer.";
-    return;
   }
 
-  RTC_LOG(LS_INFO) << "Received message from peer :" << message;
-
-/*
-  rtc::scoped_refptr<MyStatsCollector> stats_collector(new rtc::RefCountedObject<MyStatsCollector>("output_stats.txt"));
-  peer_connection_->GetStats(stats_collector.get());
-
+  RTC_LOG(LS_INFO) << "[" << SharedTimestamp(client_->clock_offset())
+                   << "] Received message from peer " << peer_id << " :"
+                   << message;
 
-  MyStatsObserver* stats_observer = new MyStatsObserver();
-  peer_connection_->GetStats(stats_observer, nullptr, webrtc::PeerConnectionInterface::kStatsOutputLevelStandard);
-*/
-
-  Json::CharReaderBuilder factory;
-  std::unique_ptr<Json::CharReader> reader =
-      absl::WrapUnique(factory.newCharReader());
-  Json::Value jmessage;
-  if (!reader->parse(message.data(), message.data() + message.length(),
-                     &jmessage, nullptr)) {
-    RTC_LOG(LS_WARNING) << "Received unknown message. " << message;
-    return;
-  }
-  std::string type_str;
-  std::string json_object;
-
-  rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionTypeName,
-                               &type_str);
-  if (!type_str.empty()) {
-    if (type_str == "offer-loopback") {
-      // This is a loopback call.
-      // Recreate the peerconnection with DTLS disabled.
-      if (!ReinitializePeerConnectionForLoopback()) {
-        RTC_LOG(LS_ERROR) << "Failed to initialize our PeerConnection instance";
-        DeletePeerConnection();
-        client_->SignOut();
-      }
-      return;
-    }
-    absl::optional<webrtc::SdpType> type_maybe =
-        webrtc::SdpTypeFromString(type_str);
-    if (!type_maybe) {
-      RTC_LOG(LS_ERROR) << "Unknown SDP type: " << type_str;
-      return;
-    }
-    webrtc::SdpType type = *type_maybe;
-    std::string sdp;
-    if (!rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionSdpName,
-                                      &sdp)) {
-      RTC_LOG(LS_WARNING)
-          << "Can't parse received session description message.";
-      return;
-    }
-    webrtc::SdpParseError error;
-    std::unique_ptr<webrtc::SessionDescriptionInterface> session_description =
-        webrtc::CreateSessionDescription(type, sdp, &error);
-    if (!session_description) {
-      RTC_LOG(LS_WARNING)
-          << "Can't parse received session description message. "
-             "SdpParseError was: "
-          << error.description;
-      return;
-    }
-    RTC_LOG(LS_INFO) << " Received session description :" << message;
-    peer_connection_->SetRemoteDescription(
-        DummySetSessionDescriptionObserver::Create().get(),
-        session_description.release());
-    if (type == webrtc::SdpType::kOffer) {
-      peer_connection_->CreateAnswer(
-          this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
-    }
-  } else {
-    std::string sdp_mid;
-    int sdp_mlineindex = 0;
-    std::string sdp;
-    if (!rtc::GetStringFromJsonObject(jmessage, kCandidateSdpMidName,
-                                      &sdp_mid) ||
-        !rtc::GetIntFromJsonObject(jmessage, kCandidateSdpMlineIndexName,
-                                   &sdp_mlineindex) ||
-        !rtc::GetStringFromJsonObject(jmessage, kCandidateSdpName, &sdp)) {
-      RTC_LOG(LS_WARNING) << "Can't parse received message.";
-      return;
-    }
-    webrtc::SdpParseError error;
-    std::unique_ptr<webrtc::IceCandidateInterface> candidate(
-        webrtc::CreateIceCandidate(sdp_mid, sdp_mlineindex, sdp, &error));
-    if (!candidate.get()) {
-      RTC_LOG(LS_WARNING) << "Can't parse received candidate message. "
-                             "SdpParseError was: "
-                          << error.description;
-      return;
-    }
-    if (!peer_connection_->AddIceCandidate(candidate.get())) {
-      RTC_LOG(LS_WARNING) << "Failed to apply the received candidate";
+  // Peers batch the messages that queue up while they're waiting on the
+  // server into a JSON array.
+  SignalingMessageReader reader(message);
+  while (reader.Next(&incoming_message_)) {
+    if (!session->OnSignalingMessage(incoming_message_)) {
+      DeleteSession(peer_id);
+      client_->SignOut();
       return;
     }
-    RTC_LOG(LS_INFO) << " Received candidate :" << message;
   }
+  if (reader.failed())
+    RTC_LOG(LS_WARNING) << "Received unknown message. " << message;
 }
 
 void Conductor::OnMessageSent(int err) {
+  timeline_.Mark(last_sent_peer_id_, SignalingTimeline::kSignaling,
+                 "message_acked", std::to_string(err));
   // Process the next pending message if any.
   main_wnd_->QueueUIThreadCallback(SEND_MESSAGE_TO_PEER, NULL);
 }
@@ -645,6 +721,7 @@ void Conductor::StartLogin(const std::string& server, int port) {
   if (client_->is_connected())
     return;
   server_ = server;
+  timeline_.BeginSession();
   client_->Connect(server, port, GetPeerName());
 }
 
@@ -654,75 +731,123 @@ void Conductor::DisconnectFromServer() {
 }
 
 void Conductor::ConnectToPeer(int peer_id) {
-  RTC_DCHECK(peer_id_ == -1);
   RTC_DCHECK(peer_id != -1);
 
-  if (peer_connection_.get()) {
+  if (sessions_.find(peer_id) != sessions_.end()) {
+    main_wnd_->MessageBox("Error", "Already in a call with this peer", true);
+    return;
+  }
+  if (at_session_limit()) {
     main_wnd_->MessageBox(
-        "Error", "We only support connecting to one peer at a time", true);
+        "Error",
+        max_sessions_ == 1
+            ? "We only support connecting to one peer at a time"
+            : ("We only support connecting to " +
+               std::to_string(max_sessions_) + " peers at a time")
+                  .c_str(),
+        true);
     return;
   }
 
-  if (InitializePeerConnection()) {
-    peer_id_ = peer_id;
-    peer_connection_->CreateOffer(
-        this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+  PeerSession* session = CreateSession(peer_id);
+  if (session) {
+    session->CreateOffer();
   } else {
     main_wnd_->MessageBox("Error", "Failed to initialize PeerConnection", true);
   }
 }
 
-void Conductor::AddTracks() {
-  if (!peer_connection_->GetSenders().empty()) {
-    return;  // Already added tracks.
-  }
+void Conductor::CreateLocalTracks() {
+  RTC_DCHECK(local_tracks_.empty());
 
-  rtc::scoped_refptr<webrtc::AudioTrackInterface> audio_track(
-      peer_connection_factory_->CreateAudioTrack(
-          kAudioLabel,
-          peer_connection_factory_->CreateAudioSource(cricket::AudioOptions())
-              .get()));
-  auto result_or_error = peer_connection_->AddTrack(audio_track, {kStreamId});
-  if (!result_or_error.ok()) {
-    RTC_LOG(LS_ERROR) << "Failed to add audio track to PeerConnection: "
-                      << result_or_error.error().message();
-  }
+  local_tracks_.push_back(peer_connection_factory_->CreateAudioTrack(
+      kAudioLabel,
+      peer_connection_factory_->CreateAudioSource(cricket::AudioOptions())
+          .get()));
 
-  rtc::scoped_refptr<CapturerTrackSource> video_device =
-      CapturerTrackSource::Create();
+  rtc::scoped_refptr<webrtc::VideoTrackSourceInterface> video_device;
+  if (!video_file_.path.empty())
+    video_device = FileVideoTrackSource::Create(video_file_);
+  else if (video_generator_)
+    video_device = GeneratedVideoTrackSource::Create(*video_generator_);
+  else if (passthrough_video_)
+    video_device = GeneratedVideoTrackSource::Create(PassthroughPacing());
+  else
+    video_device = CapturerTrackSource::Create();
   if (video_device) {
     rtc::scoped_refptr<webrtc::VideoTrackInterface> video_track_(
         peer_connection_factory_->CreateVideoTrack(video_device, kVideoLabel));
     main_wnd_->StartLocalRenderer(video_track_.get());
-
-    result_or_error = peer_connection_->AddTrack(video_track_, {kStreamId});
-    if (!result_or_error.ok()) {
-      RTC_LOG(LS_ERROR) << "Failed to add video track to PeerConnection: "
-                        << result_or_error.error().message();
-    }
+    local_tracks_.push_back(video_track_);
   } else {
     RTC_LOG(LS_ERROR) << "OpenVideoCaptureDevice failed";
   }
+}
 
-  main_wnd_->SwitchToStreamingUI();
+VideoGeneratorOptions Conductor::PassthroughPacing() const {
+  // The encoder ignores the pixels, so the cheapest pattern will do, at the
+  // size and rate of the file so that frames are never late.
+  VideoGeneratorOptions options;
+  options.pattern = VideoGeneratorOptions::kCounter;
+  options.width = passthrough_video_->width();
+  options.height = passthrough_video_->height();
+  options.fps = passthrough_video_->fps();
+  return options;
 }
 
 void Conductor::DisconnectFromCurrentPeer() {
   RTC_LOG(LS_INFO) << __FUNCTION__;
-  if (peer_connection_.get()) {
-    client_->SendHangUp(peer_id_);
-    DeletePeerConnection();
-  }
+  for (const auto& session : sessions_)
+    pending_hang_ups_.push_back(session.first);
+  DeleteAllSessions();
+  SendNextMessage();
 
   if (main_wnd_->IsWindow())
     main_wnd_->SwitchToPeerList(client_->peers());
 }
 
+void Conductor::SendNextMessage() {
+  if (client_->IsSendingMessage())
+    return;
+
+  if (!pending_hang_ups_.empty()) {
+    int peer_id = pending_hang_ups_.front();
+    pending_hang_ups_.pop_front();
+    last_sent_peer_id_ = peer_id;
+    client_->SendHangUp(peer_id);
+    return;
+  }
+
+  // Peers take turns, starting after the one whose messages went last.
+  auto next = sessions_.upper_bound(last_sent_peer_id_);
+  for (size_t i = 0; i < sessions_.size(); ++i, ++next) {
+    if (next == sessions_.end())
+      next = sessions_.begin();
+    PeerSession* session = next->second.get();
+    if (!session->has_pending_messages())
+      continue;
+
+    // Everything that queued up while the previous POST was in flight,
+    // such as a burst of ICE candidates, goes out in one POST.
+    int peer_id = session->peer_id();
+    last_sent_peer_id_ = peer_id;
+    timeline_.Mark(peer_id, SignalingTimeline::kSignaling, "message_sent");
+    if (!client_->SendToPeer(peer_id, session->TakeSignalingBatch())) {
+      RTC_LOG(LS_ERROR) << "SendToPeer failed";
+      DisconnectFromServer();
+    }
+    return;
+  }
+}
+
 void Conductor::UIThreadCallback(int msg_id, void* data) {
   switch (msg_id) {
-    case PEER_CONNECTION_CLOSED:
+    case PEER_CONNECTION_CLOSED: {
       RTC_LOG(LS_INFO) << "PEER_CONNECTION_CLOSED";
-      DeletePeerConnection();
+      std::unique_ptr<PeerEvent> event(reinterpret_cast<PeerEvent*>(data));
+      DeleteSession(event->peer_id);
+      if (!sessions_.empty())
+        break;
 
       if (main_wnd_->IsWindow()) {
         if (client_->is_connected()) {
@@ -734,89 +859,50 @@ void Conductor::UIThreadCallback(int msg_id, void* data) {
         DisconnectFromServer();
       }
       break;
+    }
 
     case SEND_MESSAGE_TO_PEER: {
-      RTC_LOG(LS_INFO) << "SEND_MESSAGE_TO_PEER";
-      std::string* msg = reinterpret_cast<std::string*>(data);
-      if (msg) {
+      RTC_LOG(LS_INFO) << "[" << SharedTimestamp(client_->clock_offset())
+                       << "] SEND_MESSAGE_TO_PEER";
+      std::unique_ptr<PeerEvent> event(reinterpret_cast<PeerEvent*>(data));
+      if (event) {
         // For convenience, we always run the message through the queue.
         // This way we can be sure that messages are sent to the server
         // in the same order they were signaled without much hassle.
-        pending_messages_.push_back(msg);
-      }
-
-      if (!pending_messages_.empty() && !client_->IsSendingMessage()) {
-        msg = pending_messages_.front();
-        pending_messages_.pop_front();
-
-        if (!client_->SendToPeer(peer_id_, *msg) && peer_id_ != -1) {
-          RTC_LOG(LS_ERROR) << "SendToPeer failed";
-          DisconnectFromServer();
-        }
-        delete msg;
+        auto session = sessions_.find(event->peer_id);
+        if (session != sessions_.end())
+          session->second->QueueMessage(std::move(event->message));
       }
-
-      if (!peer_connection_.get())
-        peer_id_ = -1;
-
+      SendNextMessage();
       break;
     }
 
     case NEW_TRACK_ADDED: {
-      auto* track = reinterpret_cast<webrtc::MediaStreamTrackInterface*>(data);
-      if (track->kind() == webrtc::MediaStreamTrackInterface::kVideoKind) {
-        auto* video_track = static_cast<webrtc::VideoTrackInterface*>(track);
-        main_wnd_->StartRemoteRenderer(video_track);
+      std::unique_ptr<PeerEvent> event(reinterpret_cast<PeerEvent*>(data));
+      // Only one session's remote video is shown at a time.
+      if (event->track->kind() ==
+              webrtc::MediaStreamTrackInterface::kVideoKind &&
+          rendered_peer_id_ == -1 &&
+          sessions_.find(event->peer_id) != sessions_.end()) {
+        main_wnd_->StartRemoteRenderer(
+            static_cast<webrtc::VideoTrackInterface*>(event->track.get()));
+        rendered_peer_id_ = event->peer_id;
       }
-      track->Release();
       break;
     }
 
     case TRACK_REMOVED: {
       // Remote peer stopped sending a track.
-      auto* track = reinterpret_cast<webrtc::MediaStreamTrackInterface*>(data);
-      track->Release();
+      delete reinterpret_cast<PeerEvent*>(data);
       break;
     }
 
+    case WARM_STANDBY_SESSION:
+      WarmStandbySession();
+      break;
+
     default:
       RTC_DCHECK_NOTREACHED();
       break;
   }
 }
-
-void Conductor::OnSuccess(webrtc::SessionDescriptionInterface* desc) {
-  peer_connection_->SetLocalDescription(
-      DummySetSessionDescriptionObserver::Create().get(), desc);
-
-  std::string sdp;
-  desc->ToString(&sdp);
-
-  // For loopback test. To save some connecting delay.
-  if (loopback_) {
-    // Replace message type from "offer" to "answer"
-    std::unique_ptr<webrtc::SessionDescriptionInterface> session_description =
-        webrtc::CreateSessionDescription(webrtc::SdpType::kAnswer, sdp);
-    peer_connection_->SetRemoteDescription(
-        DummySetSessionDescriptionObserver::Create().get(),
-        session_description.release());
-    return;
-  }
-
-  Json::Value jmessage;
-  jmessage[kSessionDescriptionTypeName] =
-      webrtc::SdpTypeToString(desc->GetType());
-  jmessage[kSessionDescriptionSdpName] = sdp;
-
-  Json::StreamWriterBuilder factory;
-  SendMessage(Json::writeString(factory, jmessage));
-}
-
-void Conductor::OnFailure(webrtc::RTCError error) {
-  RTC_LOG(LS_ERROR) << ToString(error.type()) << ": " << error.message();
-}
-
-void Conductor::SendMessage(const std::string& json_object) {
-  std::string* msg = new std::string(json_object);
-  main_wnd_->QueueUIThreadCallback(SEND_MESSAGE_TO_PEER, msg);
-}
@@ -11,16 +11,29 @@
 #ifndef EXAMPLES_PEERCONNECTION_CLIENT_CONDUCTOR_H_
 #define EXAMPLES_PEERCONNECTION_CLIENT_CONDUCTOR_H_
 
+#include <atomic>
 #include <deque>
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/types/optional.h"
 #include "api/media_stream_interface.h"
 #include "api/peer_connection_interface.h"
+#include "examples/headless_peerconnection/client/certificate_pool.h"
+#include "examples/headless_peerconnection/client/fake_audio_device.h"
+#include "examples/headless_peerconnection/client/file_video_source.h"
+#include "examples/headless_peerconnection/client/generated_video_source.h"
+#include "examples/headless_peerconnection/client/ivf_passthrough_encoder.h"
 #include "examples/headless_peerconnection/client/main_wnd.h"
 #include "examples/headless_peerconnection/client/headless_peer_connection_client.h"
+#include "examples/headless_peerconnection/client/peer_session.h"
+#include "examples/headless_peerconnection/client/signaling_codec.h"
+#include "examples/headless_peerconnection/client/signaling_timeline.h"
+#include "examples/headless_peerconnection/client/thread_placement.h"
+#include "rtc_base/synchronization/mutex.h"
 #include "rtc_base/thread.h"
 
 
@@ -33,8 +46,11 @@ namespace cricket {
 class VideoRenderer;
 }  // namespace cricket
 
-class Conductor : public webrtc::PeerConnectionObserver,
-                  public webrtc::CreateSessionDescriptionObserver,
+// Runs the calls of a client, each with a different peer, on one
+// PeerConnectionFactory and one set of local tracks.  The calls share the
+// client's connection to the server: messages to the peers are sent one at a
+// time, taking turns between the peers that have some queued.
+class Conductor : public PeerSessionObserver,
                   public PeerConnectionClientObserver,
                   public MainWndCallback {
  public:
@@ -44,6 +60,7 @@ class Conductor : public webrtc::PeerConnectionObserver,
     SEND_MESSAGE_TO_PEER,
     NEW_TRACK_ADDED,
     TRACK_REMOVED,
+    WARM_STANDBY_SESSION,
   };
 
   Conductor(PeerConnectionClient* client, MainWindow* main_wnd);
@@ -66,36 +83,100 @@ class Conductor : public webrtc::PeerConnectionObserver,
   void StopLegacyStatsThread();
   void StopStatsThread();
 
+  // Writes a signaling trace of every call into `dir`, if not empty.
+  void set_signaling_trace_dir(const std::string& dir) {
+    signaling_trace_dir_ = dir;
+  }
+
+  // Calls beyond `max_sessions` at a time are turned down.  0 takes any
+  // number of them.
+  void set_max_sessions(int max_sessions) { max_sessions_ = max_sessions; }
+
+  // With a nonzero `ice_candidate_pool_size`, a standby PeerConnection is
+  // kept ready while signed in: created with the local tracks, its DTLS
+  // certificate and that many sets of ICE candidates, and handed to the
+  // next call.
+  void set_prewarm(int ice_candidate_pool_size) {
+    prewarm_pool_size_ = ice_candidate_pool_size;
+  }
+
+  // Where the network, worker and signaling threads of the factory run.
+  // Takes effect when InitializePeerConnectionFactory() starts them.
+  void set_thread_placements(const ThreadPlacement& network,
+                             const ThreadPlacement& worker,
+                             const ThreadPlacement& signaling) {
+    network_placement_ = network;
+    worker_placement_ = worker;
+    signaling_placement_ = signaling;
+  }
+
+  // Sends the frames of a Y4M or I420 file, looped, instead of capturing
+  // from a camera.
+  void set_video_file(const VideoFileOptions& options) {
+    video_file_ = options;
+  }
+
+  // Sends generated frames instead of capturing from a camera.  A video
+  // file takes precedence.
+  void set_video_generator(const VideoGeneratorOptions& options) {
+    video_generator_ = options;
+  }
+
+  // Sends the frames of `file` as they are instead of encoding video.  The
+  // local video source then only paces the encoder, and is a cheap
+  // generated one unless a file or pattern is set.
+  void set_passthrough_video(rtc::scoped_refptr<IvfFile> file) {
+    passthrough_video_ = std::move(file);
+  }
+
+  // Plays and records audio without a sound card or audio daemon, if
+  // `options` ask for it.
+  void set_fake_audio(const FakeAudioOptions& options) {
+    fake_audio_ = options;
+  }
+
+  // Hands every new PeerConnection a DTLS certificate out of a pool of
+  // `size`, generated in the background.  With a `dir`, the certificates
+  // left over are saved there at Close() for the next run.
+  void EnableCertificatePool(size_t size, const std::string& dir);
+
+  // Creates the PeerConnectionFactory, unless it exists already.  It's kept
+  // until Close(), so calls after the first one skip setting up the codecs
+  // and the audio device.  Called at startup to take that cost off the
+  // first call too.
+  bool InitializePeerConnectionFactory();
+
  protected:
   ~Conductor();
-  bool InitializePeerConnection();
-  bool ReinitializePeerConnectionForLoopback();
-  bool CreatePeerConnection();
-  void DeletePeerConnection();
+  // Starts a session with `peer_id`, creating the local tracks for the
+  // first one.
+  PeerSession* CreateSession(int peer_id);
+  void DeleteSession(int peer_id);
+  void DeleteAllSessions();
+  // Creates the standby session, if pre-warming and there's none.
+  void WarmStandbySession();
+  void DeleteStandbySession();
+  rtc::scoped_refptr<rtc::RTCCertificate> TakeCertificate();
   void EnsureStreamingUI();
-  void AddTracks();
+  void CreateLocalTracks();
+  // The generated video that paces the passthrough encoder.
+  VideoGeneratorOptions PassthroughPacing() const;
+  bool at_session_limit() const;
+  // The PeerConnections of all sessions, for the stats threads.
+  std::map<int, rtc::scoped_refptr<webrtc::PeerConnectionInterface>>
+  GetPeerConnections() const;
 
   //
-  // PeerConnectionObserver implementation.
+  // PeerSessionObserver implementation.
   //
 
-  void OnSignalingChange(
-      webrtc::PeerConnectionInterface::SignalingState new_state) override {}
-  void OnAddTrack(
-      rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
-      const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>&
-          streams) override;
-  void OnRemoveTrack(
-      rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) override;
-  void OnDataChannel(
-      rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override {}
-  void OnRenegotiationNeeded() override {}
-  void OnIceConnectionChange(
-      webrtc::PeerConnectionInterface::IceConnectionState new_state) override {}
-  void OnIceGatheringChange(
-      webrtc::PeerConnectionInterface::IceGatheringState new_state) override {}
-  void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override;
-  void OnIceConnectionReceivingChange(bool receiving) override {}
+  void OnSessionMessage(int peer_id, std::string message) override;
+  void OnSessionTrackAdded(
+      int peer_id,
+      rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track) override;
+  void OnSessionTrackRemoved(
+      int peer_id,
+      rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track) override;
 
   //
   // PeerConnectionClientObserver implementation.
@@ -129,27 +210,72 @@ class Conductor : public webrtc::PeerConnectionObserver,
 
   void UIThreadCallback(int msg_id, void* data) override;
 
-  // CreateSessionDescriptionObserver implementation.
-  void OnSuccess(webrtc::SessionDescriptionInterface* desc) override;
-  void OnFailure(webrtc::RTCError error) override;
-
- protected:
-  // Send a message to the remote peer.
-  void SendMessage(const std::string& json_object);
+  // Data of the UI thread callbacks about a session.  Which of `message` and
+  // `track` is set depends on the callback.
+  struct PeerEvent {
+    int peer_id;
+    std::string message;
+    rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track;
+  };
 
-  int peer_id_;
-  bool loopback_;
+  // Sends the next batch of messages to a peer, unless a message is in
+  // flight already.
+  void SendNextMessage();
+
+  // Starts `thread` named `name`, with a socket server if `with_sockets`,
+  // and places it.
+  void StartThread(std::unique_ptr<rtc::Thread>* thread,
+                   const char* name,
+                   bool with_sockets,
+                   const ThreadPlacement& placement);
+
+  // Created with the factory, instead of letting it start its own threads,
+  // so that they have names and can be placed.
+  std::unique_ptr<rtc::Thread> network_thread_;
+  std::unique_ptr<rtc::Thread> worker_thread_;
   std::unique_ptr<rtc::Thread> signaling_thread_;
-  rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
+  ThreadPlacement network_placement_;
+  ThreadPlacement worker_placement_;
+  ThreadPlacement signaling_placement_;
+  FakeAudioOptions fake_audio_;
+  // For the fake audio device's 10 ms task queue.  Outlives the factory,
+  // which owns the device.
+  std::unique_ptr<webrtc::TaskQueueFactory> task_queue_factory_;
   rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
       peer_connection_factory_;
+  // The tracks every session sends.
+  std::vector<rtc::scoped_refptr<webrtc::MediaStreamTrackInterface>>
+      local_tracks_;
   PeerConnectionClient* client_;
   MainWindow* main_wnd_;
-  std::deque<std::string*> pending_messages_;
+  // Changed on the main thread with `sessions_lock_` held, which the stats
+  // threads take to read it.
+  std::map<int, rtc::scoped_refptr<PeerSession>> sessions_;
+  mutable webrtc::Mutex sessions_lock_;
+  int max_sessions_;
+  // Peers to send a hang-up to, before any other messages.
+  std::deque<int> pending_hang_ups_;
+  // The peer whose messages were sent last; the others go first next time.
+  int last_sent_peer_id_;
+  // The session whose remote video is rendered, or -1.
+  int rendered_peer_id_;
+  // Ready for the next call, if pre-warming.  Not in `sessions_`, so the
+  // stats threads don't see it.
+  rtc::scoped_refptr<PeerSession> standby_session_;
+  int prewarm_pool_size_;
+  std::unique_ptr<CertificatePool> certificate_pool_;
+  VideoFileOptions video_file_;
+  absl::optional<VideoGeneratorOptions> video_generator_;
+  rtc::scoped_refptr<IvfFile> passthrough_video_;
+  // Reused for every message received, to keep its buffers.
+  SignalingMessage incoming_message_;
   std::string server_;
   std::unique_ptr<rtc::Thread> stats_thread_;
   std::unique_ptr<rtc::Thread> legacy_stats_thread_;
   std::atomic<bool> continue_collecting_stats_;
+  SignalingTimeline timeline_;
+  std::string signaling_trace_dir_;
+  int calls_traced_;
 };
 
 #endif  // EXAMPLES_PEERCONNECTION_CLIENT_CONDUCTOR_H_
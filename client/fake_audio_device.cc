@@ -0,0 +1,111 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/fake_audio_device.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <utility>
+
+#include "api/array_view.h"
+#include "modules/audio_device/include/test_audio_device.h"
+#include "rtc_base/buffer.h"
+#include "rtc_base/logging.h"
+
+namespace {
+
+const int kSamplingFrequencyHz = 48000;
+const int kToneFrequencyHz = 440;
+// About -6 dBFS.
+const int16_t kAmplitude = 16384;
+const double kTwoPi = 6.283185307179586;
+
+// A sine wave, or silence at amplitude 0.
+class ToneCapturer : public webrtc::TestAudioDeviceModule::Capturer {
+ public:
+  ToneCapturer(int frequency_hz, int16_t amplitude)
+      : phase_step_(kTwoPi * frequency_hz / kSamplingFrequencyHz),
+        amplitude_(amplitude),
+        phase_(0) {}
+
+  int SamplingFrequency() const override { return kSamplingFrequencyHz; }
+  int NumChannels() const override { return 1; }
+
+  bool Capture(rtc::BufferT<int16_t>* buffer) override {
+    buffer->SetData(
+        webrtc::TestAudioDeviceModule::SamplesPerFrame(kSamplingFrequencyHz),
+        [this](rtc::ArrayView<int16_t> samples) {
+          for (int16_t& sample : samples) {
+            sample = static_cast<int16_t>(amplitude_ * sin(phase_));
+            phase_ += phase_step_;
+            if (phase_ >= kTwoPi)
+              phase_ -= kTwoPi;
+          }
+          return samples.size();
+        });
+    return true;
+  }
+
+ private:
+  const double phase_step_;
+  const int16_t amplitude_;
+  double phase_;
+};
+
+std::unique_ptr<webrtc::TestAudioDeviceModule::Capturer> CreateCapturer(
+    const std::string& input) {
+  if (input.empty())
+    return std::make_unique<ToneCapturer>(kToneFrequencyHz, 0);
+  if (input == "tone")
+    return std::make_unique<ToneCapturer>(kToneFrequencyHz, kAmplitude);
+  if (input == "noise") {
+    return webrtc::TestAudioDeviceModule::CreatePulsedNoiseCapturer(
+        kAmplitude, kSamplingFrequencyHz);
+  }
+  // The WAV reader can't fail gracefully on a missing file.
+  FILE* file = fopen(input.c_str(), "rb");
+  if (!file) {
+    RTC_LOG(LS_ERROR) << "Failed to open audio file: " << input;
+    return nullptr;
+  }
+  fclose(file);
+  return webrtc::TestAudioDeviceModule::CreateWavFileReader(input,
+                                                            /*repeat=*/true);
+}
+
+std::unique_ptr<webrtc::TestAudioDeviceModule::Renderer> CreateRenderer(
+    const std::string& output) {
+  if (output.empty() || output == "discard") {
+    return webrtc::TestAudioDeviceModule::CreateDiscardRenderer(
+        kSamplingFrequencyHz);
+  }
+  return webrtc::TestAudioDeviceModule::CreateWavFileWriter(
+      output, kSamplingFrequencyHz);
+}
+
+}  // namespace
+
+rtc::scoped_refptr<webrtc::AudioDeviceModule> CreateFakeAudioDevice(
+    webrtc::TaskQueueFactory* task_queue_factory,
+    const FakeAudioOptions& options) {
+  std::unique_ptr<webrtc::TestAudioDeviceModule::Capturer> capturer =
+      CreateCapturer(options.input);
+  if (!capturer)
+    return nullptr;
+  RTC_LOG(LS_INFO) << "Fake audio device: input "
+                   << (options.input.empty() ? "silence" : options.input)
+                   << ", output "
+                   << (options.output.empty() ? "discard" : options.output);
+  return webrtc::TestAudioDeviceModule::Create(
+      task_queue_factory, std::move(capturer), CreateRenderer(options.output));
+}
@@ -0,0 +1,40 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_FAKE_AUDIO_DEVICE_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_FAKE_AUDIO_DEVICE_H_
+
+#include <string>
+
+#include "api/audio/audio_device.h"
+#include "api/scoped_refptr.h"
+#include "api/task_queue/task_queue_factory.h"
+
+// Audio played and recorded without a sound card or audio daemon.  Empty
+// for both means the platform's audio devices.
+struct FakeAudioOptions {
+  // "tone" for a 440 Hz sine, "noise" for pulsed noise, or a WAV file that
+  // is played in a loop.
+  std::string input;
+  // "discard" to drop the received audio, or a WAV file to record it to.
+  std::string output;
+
+  bool enabled() const { return !input.empty() || !output.empty(); }
+};
+
+// Creates an audio device module that captures from and renders to what
+// `options` asks for, every 10 ms on a task queue from `task_queue_factory`.
+// An empty input sends silence and an empty output discards.  Returns null
+// if an input file can't be read.
+rtc::scoped_refptr<webrtc::AudioDeviceModule> CreateFakeAudioDevice(
+    webrtc::TaskQueueFactory* task_queue_factory,
+    const FakeAudioOptions& options);
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_FAKE_AUDIO_DEVICE_H_
@@ -0,0 +1,251 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/file_video_source.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <utility>
+
+#if defined(WEBRTC_POSIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "common_video/include/video_frame_buffer.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/ref_count.h"
+
+// The whole file, read-only.  Frames handed out hold a reference, so the
+// mapping outlives the source as long as an encoder still has a frame.
+class FileVideoTrackSource::MappedFile : public rtc::RefCountInterface {
+ public:
+  static rtc::scoped_refptr<MappedFile> Open(const std::string& path) {
+    auto file = rtc::make_ref_counted<MappedFile>();
+    if (!file->Map(path))
+      return nullptr;
+    return file;
+  }
+
+  ~MappedFile() override {
+#if defined(WEBRTC_POSIX)
+    if (data_)
+      munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+  }
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+#if defined(WEBRTC_POSIX)
+  bool Map(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+      close(fd);
+      return false;
+    }
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+      return false;
+    // Frames are read front to back, and again on every loop.
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t*>(data);
+    size_ = info.st_size;
+    return true;
+  }
+#else
+  // Read into memory instead, where there's no mmap().
+  bool Map(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+      return false;
+    uint8_t buffer[64 * 1024];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      contents_.insert(contents_.end(), buffer, buffer + read);
+    fclose(file);
+    data_ = contents_.data();
+    size_ = contents_.size();
+    return size_ > 0;
+  }
+
+  std::vector<uint8_t> contents_;
+#endif
+
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+namespace {
+
+const char kY4mSignature[] = "YUV4MPEG2 ";
+const char kY4mFrameTag[] = "FRAME";
+
+size_t I420FrameSize(int width, int height) {
+  size_t chroma = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+  return static_cast<size_t>(width) * height + 2 * chroma;
+}
+
+// Reads the stream header of a Y4M file and finds its frames.  Only 4:2:0
+// chroma is accepted, which is what the C tag defaults to.
+bool ParseY4m(const uint8_t* data,
+              size_t size,
+              int* width,
+              int* height,
+              int* fps_numerator,
+              int* fps_denominator,
+              std::vector<size_t>* frame_offsets) {
+  absl::string_view file(reinterpret_cast<const char*>(data), size);
+  size_t header_end = file.find('\n');
+  if (header_end == absl::string_view::npos)
+    return false;
+  *width = *height = 0;
+  *fps_numerator = 30;
+  *fps_denominator = 1;
+  for (absl::string_view param :
+       absl::StrSplit(file.substr(sizeof(kY4mSignature) - 1,
+                                  header_end - (sizeof(kY4mSignature) - 1)),
+                      ' ', absl::SkipEmpty())) {
+    absl::string_view value = param.substr(1);
+    switch (param[0]) {
+      case 'W':
+        if (!absl::SimpleAtoi(value, width))
+          return false;
+        break;
+      case 'H':
+        if (!absl::SimpleAtoi(value, height))
+          return false;
+        break;
+      case 'F': {
+        std::pair<absl::string_view, absl::string_view> rate =
+            absl::StrSplit(value, ':');
+        if (!absl::SimpleAtoi(rate.first, fps_numerator) ||
+            !absl::SimpleAtoi(rate.second, fps_denominator) ||
+            *fps_numerator <= 0 || *fps_denominator <= 0) {
+          return false;
+        }
+        break;
+      }
+      case 'C':
+        if (!absl::StartsWith(value, "420")) {
+          RTC_LOG(LS_ERROR) << "Unsupported Y4M chroma format: " << value;
+          return false;
+        }
+        break;
+    }
+  }
+  if (*width <= 0 || *height <= 0)
+    return false;
+
+  // Every frame has a header of its own, which may carry parameters.
+  size_t frame_size = I420FrameSize(*width, *height);
+  size_t pos = header_end + 1;
+  while (pos < file.size()) {
+    if (file.substr(pos, sizeof(kY4mFrameTag) - 1) != kY4mFrameTag)
+      return false;
+    size_t tag_end = file.find('\n', pos);
+    if (tag_end == absl::string_view::npos ||
+        file.size() - (tag_end + 1) < frame_size) {
+      break;  // A truncated last frame is left out.
+    }
+    frame_offsets->push_back(tag_end + 1);
+    pos = tag_end + 1 + frame_size;
+  }
+  return !frame_offsets->empty();
+}
+
+}  // namespace
+
+rtc::scoped_refptr<FileVideoTrackSource> FileVideoTrackSource::Create(
+    const VideoFileOptions& options) {
+  rtc::scoped_refptr<MappedFile> file = MappedFile::Open(options.path);
+  if (!file) {
+    RTC_LOG(LS_ERROR) << "Failed to open video file: " << options.path;
+    return nullptr;
+  }
+
+  int width = options.width;
+  int height = options.height;
+  int fps_numerator = options.fps;
+  int fps_denominator = 1;
+  std::vector<size_t> frame_offsets;
+  absl::string_view start(reinterpret_cast<const char*>(file->data()),
+                          file->size());
+  if (absl::StartsWith(start, kY4mSignature)) {
+    if (!ParseY4m(file->data(), file->size(), &width, &height, &fps_numerator,
+                  &fps_denominator, &frame_offsets)) {
+      RTC_LOG(LS_ERROR) << "Malformed Y4M file: " << options.path;
+      return nullptr;
+    }
+  } else {
+    if (width <= 0 || height <= 0 || fps_numerator <= 0)
+      return nullptr;
+    size_t frame_size = I420FrameSize(width, height);
+    if (file->size() % frame_size != 0) {
+      RTC_LOG(LS_ERROR) << options.path << " isn't a whole number of "
+                        << width << "x" << height << " I420 frames";
+      return nullptr;
+    }
+    for (size_t offset = 0; offset < file->size(); offset += frame_size)
+      frame_offsets.push_back(offset);
+  }
+
+  RTC_LOG(LS_INFO) << "Playing " << frame_offsets.size() << " frames of "
+                   << width << "x" << height << " at " << fps_numerator << "/"
+                   << fps_denominator << " fps from " << options.path;
+  auto source = rtc::make_ref_counted<FileVideoTrackSource>(
+      std::move(file), width, height, fps_numerator, fps_denominator,
+      std::move(frame_offsets));
+  source->Start("file_video");
+  return source;
+}
+
+FileVideoTrackSource::FileVideoTrackSource(
+    rtc::scoped_refptr<MappedFile> file,
+    int width,
+    int height,
+    int fps_numerator,
+    int fps_denominator,
+    std::vector<size_t> frame_offsets)
+    : PacedVideoTrackSource(fps_numerator, fps_denominator),
+      file_(std::move(file)),
+      width_(width),
+      height_(height),
+      frame_offsets_(std::move(frame_offsets)) {}
+
+FileVideoTrackSource::~FileVideoTrackSource() {
+  Stop();
+}
+
+rtc::scoped_refptr<webrtc::VideoFrameBuffer> FileVideoTrackSource::NextFrame(
+    int64_t index) {
+  const uint8_t* y =
+      file_->data() + frame_offsets_[index % frame_offsets_.size()];
+  int chroma_width = (width_ + 1) / 2;
+  size_t chroma_size = static_cast<size_t>(chroma_width) * ((height_ + 1) / 2);
+  const uint8_t* u = y + static_cast<size_t>(width_) * height_;
+  const uint8_t* v = u + chroma_size;
+  // The frame points into the mapping and keeps it alive.
+  rtc::scoped_refptr<MappedFile> file = file_;
+  return webrtc::WrapI420Buffer(width_, height_, y, width_, u, chroma_width, v,
+                                chroma_width, [file] {});
+}
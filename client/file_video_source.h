@@ -0,0 +1,65 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_FILE_VIDEO_SOURCE_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_FILE_VIDEO_SOURCE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "api/scoped_refptr.h"
+#include "api/video/video_frame_buffer.h"
+#include "examples/headless_peerconnection/client/paced_video_source.h"
+
+// Where FileVideoTrackSource reads its frames from.  The size and frame
+// rate are only used for raw I420 files; a Y4M file has them in its header.
+struct VideoFileOptions {
+  std::string path;
+  int width = 640;
+  int height = 480;
+  int fps = 30;
+};
+
+// Plays a Y4M or raw I420 file as the local video, looping back to the first
+// frame after the last one.  The file is mapped into memory and the frames
+// are handed to the sinks without copying them.
+class FileVideoTrackSource : public PacedVideoTrackSource {
+ public:
+  // Returns null if the file can't be read or isn't a 4:2:0 Y4M file or a
+  // whole number of I420 frames of the size in `options`.
+  static rtc::scoped_refptr<FileVideoTrackSource> Create(
+      const VideoFileOptions& options);
+
+  class MappedFile;
+
+ protected:
+  FileVideoTrackSource(rtc::scoped_refptr<MappedFile> file,
+                       int width,
+                       int height,
+                       int fps_numerator,
+                       int fps_denominator,
+                       std::vector<size_t> frame_offsets);
+  ~FileVideoTrackSource() override;
+
+ private:
+  rtc::scoped_refptr<webrtc::VideoFrameBuffer> NextFrame(
+      int64_t index) override;
+
+  const rtc::scoped_refptr<MappedFile> file_;
+  const int width_;
+  const int height_;
+  // Where the pixels of each frame start in the file.
+  const std::vector<size_t> frame_offsets_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_FILE_VIDEO_SOURCE_H_
@@ -0,0 +1,250 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/flag_defs.h"
+
+#include <stdio.h>
+
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "api/scoped_refptr.h"
+#include "api/units/time_delta.h"
+#include "examples/headless_peerconnection/client/conductor.h"
+#include "examples/headless_peerconnection/client/defaults.h"
+#include "examples/headless_peerconnection/client/fake_audio_device.h"
+#include "examples/headless_peerconnection/client/file_video_source.h"
+#include "examples/headless_peerconnection/client/generated_video_source.h"
+#include "examples/headless_peerconnection/client/headless_peer_connection_client.h"
+#include "examples/headless_peerconnection/client/ivf_passthrough_encoder.h"
+#include "examples/headless_peerconnection/client/reconnect_backoff.h"
+#include "examples/headless_peerconnection/client/thread_placement.h"
+
+ABSL_FLAG(bool,
+          autoconnect,
+          false,
+          "Connect to the server without user "
+          "intervention.");
+ABSL_FLAG(std::string, server, "localhost", "The server to connect to.");
+ABSL_FLAG(int,
+          port,
+          kDefaultServerPort,
+          "The port on which the server is listening.");
+ABSL_FLAG(
+    bool,
+    autocall,
+    false,
+    "Call the first available other client on "
+    "the server without user intervention.  Note: this flag should only be set "
+    "to true on one of the two clients.");
+
+ABSL_FLAG(int,
+          max_sessions,
+          1,
+          "Calls with different peers this client takes part in at a time, "
+          "all sharing one PeerConnectionFactory.  0 doesn't limit them.");
+
+ABSL_FLAG(int,
+          prewarm_ice_candidate_pool_size,
+          0,
+          "Keep a PeerConnection ready for the next call while signed in, "
+          "with its local tracks, DTLS certificate and this many sets of ICE "
+          "candidates gathered ahead of time.  0 creates the PeerConnection "
+          "when the call starts.");
+
+ABSL_FLAG(std::string,
+          video_file,
+          "",
+          "Y4M or raw I420 file to send as the local video, looped, instead "
+          "of capturing from a camera.");
+ABSL_FLAG(int,
+          video_file_width,
+          640,
+          "Frame width of a raw I420 --video_file.");
+ABSL_FLAG(int,
+          video_file_height,
+          480,
+          "Frame height of a raw I420 --video_file.");
+ABSL_FLAG(int, video_file_fps, 30, "Frame rate of a raw I420 --video_file.");
+
+ABSL_FLAG(std::string,
+          video_pattern,
+          "",
+          "Send generated video instead of capturing from a camera: "
+          "\"gradient\", \"noise\" or \"counter\" (the frame number in "
+          "black and white blocks along the top).  Ignored with "
+          "--video_file.");
+ABSL_FLAG(int, video_pattern_width, 640, "Width of the generated video.");
+ABSL_FLAG(int, video_pattern_height, 480, "Height of the generated video.");
+ABSL_FLAG(int, video_pattern_fps, 30, "Frame rate of the generated video.");
+
+ABSL_FLAG(std::string,
+          video_ivf,
+          "",
+          "VP8 or VP9 IVF file whose frames are sent as they are, paced by "
+          "their timestamps, instead of encoding the local video.  Only its "
+          "codec is offered.");
+
+ABSL_FLAG(std::string,
+          audio_input,
+          "",
+          "Audio to send without a sound card: \"tone\" (440 Hz), "
+          "\"noise\", or a WAV file played in a loop.  Empty uses the "
+          "microphone, unless --audio_output is set, which sends silence.");
+ABSL_FLAG(std::string,
+          audio_output,
+          "",
+          "Where received audio goes without a sound card: \"discard\" or a "
+          "WAV file to record it to.  Empty uses the speakers, unless "
+          "--audio_input is set, which discards it.");
+
+ABSL_FLAG(int,
+          certificate_pool_size,
+          0,
+          "DTLS certificates to generate in the background, ahead of the "
+          "calls that use them.  0 has every PeerConnection generate its own "
+          "while the call is set up.");
+ABSL_FLAG(std::string,
+          certificate_pool_dir,
+          "",
+          "Directory to keep the unused pooled certificates in between runs, "
+          "private keys included.  Clients sharing it may hand out the same "
+          "certificate.  Empty keeps them in memory only.");
+
+// Placement of the PeerConnectionFactory's threads.  CPU lists look like
+// "0-3,6"; priorities are "nice:<-20..19>" or "rt:<1..99>" for SCHED_FIFO.
+// Empty leaves the thread as the system made it.
+ABSL_FLAG(std::string,
+          network_thread_cpus,
+          "",
+          "CPUs the network thread runs on.");
+ABSL_FLAG(std::string,
+          network_thread_priority,
+          "",
+          "Priority of the network thread.");
+ABSL_FLAG(std::string,
+          worker_thread_cpus,
+          "",
+          "CPUs the worker thread, which runs the media engine, runs on.");
+ABSL_FLAG(std::string,
+          worker_thread_priority,
+          "",
+          "Priority of the worker thread.");
+ABSL_FLAG(std::string,
+          signaling_thread_cpus,
+          "",
+          "CPUs the signaling thread runs on.");
+ABSL_FLAG(std::string,
+          signaling_thread_priority,
+          "",
+          "Priority of the signaling thread.");
+
+ABSL_FLAG(int,
+          reconnect_initial_delay_ms,
+          500,
+          "Upper bound of the random delay before the second retry of a "
+          "failed connection to the server.  The first retry is immediate, "
+          "and the bound doubles with every retry after the second.");
+ABSL_FLAG(int,
+          reconnect_max_delay_ms,
+          30000,
+          "Cap on the random delay between retries of a failed connection "
+          "to the server.");
+ABSL_FLAG(int,
+          reconnect_max_attempts,
+          0,
+          "Retries of a failed connection to the server before giving up. "
+          "0 retries forever.");
+
+ABSL_FLAG(std::string,
+          signaling_trace_dir,
+          "",
+          "Directory to write a timeline of every call's setup into, as a "
+          "Chrome trace event JSON file per call.  Empty disables it.");
+
+ABSL_FLAG(
+    std::string,
+    force_fieldtrials,
+    "",
+    "Field trials control experimental features. This flag specifies the field "
+    "trials in effect. E.g. running with "
+    "--force_fieldtrials=WebRTC-FooFeature/Enabled/ "
+    "will assign the group Enabled to field trial WebRTC-FooFeature. Multiple "
+    "trials are separated by \"/\"");
+
+bool ConfigureConductorFromFlags(Conductor* conductor,
+                                 PeerConnectionClient* client) {
+  ThreadPlacement network_placement, worker_placement, signaling_placement;
+  if (!ParseThreadPlacement(absl::GetFlag(FLAGS_network_thread_cpus),
+                            absl::GetFlag(FLAGS_network_thread_priority),
+                            &network_placement) ||
+      !ParseThreadPlacement(absl::GetFlag(FLAGS_worker_thread_cpus),
+                            absl::GetFlag(FLAGS_worker_thread_priority),
+                            &worker_placement) ||
+      !ParseThreadPlacement(absl::GetFlag(FLAGS_signaling_thread_cpus),
+                            absl::GetFlag(FLAGS_signaling_thread_priority),
+                            &signaling_placement)) {
+    printf("Error: invalid thread CPU list or priority.\n");
+    return false;
+  }
+
+  VideoGeneratorOptions video_generator;
+  const std::string video_pattern = absl::GetFlag(FLAGS_video_pattern);
+  if (!video_pattern.empty() &&
+      !ParseVideoPattern(video_pattern, &video_generator.pattern)) {
+    printf("Error: %s is not a video pattern.\n", video_pattern.c_str());
+    return false;
+  }
+  video_generator.width = absl::GetFlag(FLAGS_video_pattern_width);
+  video_generator.height = absl::GetFlag(FLAGS_video_pattern_height);
+  video_generator.fps = absl::GetFlag(FLAGS_video_pattern_fps);
+
+  rtc::scoped_refptr<IvfFile> passthrough_video;
+  const std::string video_ivf = absl::GetFlag(FLAGS_video_ivf);
+  if (!video_ivf.empty()) {
+    passthrough_video = IvfFile::Load(video_ivf);
+    if (!passthrough_video) {
+      printf("Error: can't pass through %s.\n", video_ivf.c_str());
+      return false;
+    }
+  }
+
+  ReconnectPolicy reconnect_policy;
+  reconnect_policy.initial_delay = webrtc::TimeDelta::Millis(
+      absl::GetFlag(FLAGS_reconnect_initial_delay_ms));
+  reconnect_policy.max_delay =
+      webrtc::TimeDelta::Millis(absl::GetFlag(FLAGS_reconnect_max_delay_ms));
+  reconnect_policy.max_attempts = absl::GetFlag(FLAGS_reconnect_max_attempts);
+  client->set_reconnect_policy(reconnect_policy);
+
+  conductor->set_signaling_trace_dir(absl::GetFlag(FLAGS_signaling_trace_dir));
+  conductor->set_max_sessions(absl::GetFlag(FLAGS_max_sessions));
+  conductor->set_prewarm(absl::GetFlag(FLAGS_prewarm_ice_candidate_pool_size));
+  conductor->set_thread_placements(network_placement, worker_placement,
+                                   signaling_placement);
+  VideoFileOptions video_file;
+  video_file.path = absl::GetFlag(FLAGS_video_file);
+  video_file.width = absl::GetFlag(FLAGS_video_file_width);
+  video_file.height = absl::GetFlag(FLAGS_video_file_height);
+  video_file.fps = absl::GetFlag(FLAGS_video_file_fps);
+  conductor->set_video_file(video_file);
+  if (!video_pattern.empty())
+    conductor->set_video_generator(video_generator);
+  conductor->set_passthrough_video(passthrough_video);
+  FakeAudioOptions fake_audio;
+  fake_audio.input = absl::GetFlag(FLAGS_audio_input);
+  fake_audio.output = absl::GetFlag(FLAGS_audio_output);
+  conductor->set_fake_audio(fake_audio);
+  if (absl::GetFlag(FLAGS_certificate_pool_size) > 0) {
+    conductor->EnableCertificatePool(absl::GetFlag(FLAGS_certificate_pool_size),
+                                     absl::GetFlag(FLAGS_certificate_pool_dir));
+  }
+  return true;
+}
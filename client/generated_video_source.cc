@@ -0,0 +1,172 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/generated_video_source.h"
+
+#include <string.h>
+
+#include "rtc_base/logging.h"
+
+namespace {
+
+// Frames the encoder and renderers may hold on to before one is dropped
+// for want of a buffer.
+const size_t kMaxPooledBuffers = 8;
+
+// Extra columns of noise, so that the rows copied out of it start at a
+// different column every frame.
+const size_t kNoiseSlack = 64;
+
+// Luma of the counter's blocks, at the edges of the video range.
+const uint8_t kBlack = 16;
+const uint8_t kWhite = 235;
+const int kCounterBits = 32;
+
+void FillPlane(uint8_t* plane, int stride, int width, int height,
+               uint8_t value) {
+  for (int y = 0; y < height; ++y)
+    memset(plane + y * stride, value, width);
+}
+
+}  // namespace
+
+bool ParseVideoPattern(absl::string_view name,
+                       VideoGeneratorOptions::Pattern* pattern) {
+  if (name == "gradient") {
+    *pattern = VideoGeneratorOptions::kGradient;
+  } else if (name == "noise") {
+    *pattern = VideoGeneratorOptions::kNoise;
+  } else if (name == "counter") {
+    *pattern = VideoGeneratorOptions::kCounter;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+rtc::scoped_refptr<GeneratedVideoTrackSource> GeneratedVideoTrackSource::Create(
+    const VideoGeneratorOptions& options) {
+  if (options.width <= 0 || options.height <= 0 || options.fps <= 0)
+    return nullptr;
+  RTC_LOG(LS_INFO) << "Generating " << options.width << "x" << options.height
+                   << " video at " << options.fps << " fps";
+  auto source = rtc::make_ref_counted<GeneratedVideoTrackSource>(options);
+  source->Start("generated_video");
+  return source;
+}
+
+GeneratedVideoTrackSource::GeneratedVideoTrackSource(
+    const VideoGeneratorOptions& options)
+    : PacedVideoTrackSource(options.fps, 1),
+      options_(options),
+      pool_(/*zero_initialize=*/false, kMaxPooledBuffers),
+      pattern_stride_(0),
+      random_state_(0x9e3779b9) {
+  switch (options_.pattern) {
+    case VideoGeneratorOptions::kGradient:
+      // A ramp as long as a row plus one period; row y of frame n starts
+      // (y + 2n) into it.
+      pattern_.resize(options_.width + 256);
+      for (size_t i = 0; i < pattern_.size(); ++i)
+        pattern_[i] = static_cast<uint8_t>(i);
+      break;
+    case VideoGeneratorOptions::kNoise:
+      // Twice the rows of a frame, each frame taking a window of them.
+      pattern_stride_ = options_.width + kNoiseSlack;
+      pattern_.resize(pattern_stride_ * options_.height * 2);
+      for (uint8_t& pixel : pattern_)
+        pixel = static_cast<uint8_t>(NextRandom() >> 24);
+      break;
+    case VideoGeneratorOptions::kCounter:
+      break;
+  }
+}
+
+GeneratedVideoTrackSource::~GeneratedVideoTrackSource() {
+  Stop();
+}
+
+rtc::scoped_refptr<webrtc::VideoFrameBuffer>
+GeneratedVideoTrackSource::NextFrame(int64_t index) {
+  rtc::scoped_refptr<webrtc::I420Buffer> buffer =
+      pool_.CreateI420Buffer(options_.width, options_.height);
+  if (!buffer) {
+    RTC_LOG(LS_VERBOSE) << "No free buffer, dropping generated frame "
+                        << index;
+    return nullptr;
+  }
+
+  switch (options_.pattern) {
+    case VideoGeneratorOptions::kGradient:
+      DrawGradient(index, buffer.get());
+      break;
+    case VideoGeneratorOptions::kNoise:
+      DrawNoise(buffer.get());
+      break;
+    case VideoGeneratorOptions::kCounter:
+      DrawCounter(index, buffer.get());
+      break;
+  }
+  FillPlane(buffer->MutableDataU(), buffer->StrideU(), buffer->ChromaWidth(),
+            buffer->ChromaHeight(), 128);
+  FillPlane(buffer->MutableDataV(), buffer->StrideV(), buffer->ChromaWidth(),
+            buffer->ChromaHeight(), 128);
+  return buffer;
+}
+
+void GeneratedVideoTrackSource::DrawGradient(int64_t index,
+                                             webrtc::I420Buffer* buffer) {
+  uint8_t* y_plane = buffer->MutableDataY();
+  for (int y = 0; y < options_.height; ++y) {
+    memcpy(y_plane + y * buffer->StrideY(),
+           pattern_.data() + ((y + index * 2) & 0xff), options_.width);
+  }
+}
+
+void GeneratedVideoTrackSource::DrawNoise(webrtc::I420Buffer* buffer) {
+  size_t first_row = NextRandom() % options_.height;
+  size_t column = NextRandom() % kNoiseSlack;
+  const uint8_t* source =
+      pattern_.data() + first_row * pattern_stride_ + column;
+  uint8_t* y_plane = buffer->MutableDataY();
+  for (int y = 0; y < options_.height; ++y) {
+    memcpy(y_plane + y * buffer->StrideY(), source + y * pattern_stride_,
+           options_.width);
+  }
+}
+
+void GeneratedVideoTrackSource::DrawCounter(int64_t index,
+                                            webrtc::I420Buffer* buffer) {
+  int block = options_.width / kCounterBits;
+  if (block < 1)
+    block = 1;
+  int block_rows = block < options_.height ? block : options_.height;
+  uint8_t* y_plane = buffer->MutableDataY();
+  uint32_t counter = static_cast<uint32_t>(index);
+  for (int y = 0; y < block_rows; ++y) {
+    uint8_t* row = y_plane + y * buffer->StrideY();
+    memset(row, kBlack, options_.width);
+    for (int bit = 0; bit < kCounterBits && (bit + 1) * block <= options_.width;
+         ++bit) {
+      if (counter & (1u << (kCounterBits - 1 - bit)))
+        memset(row + bit * block, kWhite, block);
+    }
+  }
+  FillPlane(y_plane + block_rows * buffer->StrideY(), buffer->StrideY(),
+            options_.width, options_.height - block_rows, kBlack);
+}
+
+uint32_t GeneratedVideoTrackSource::NextRandom() {
+  // xorshift32: the noise only needs to look random to an encoder.
+  random_state_ ^= random_state_ << 13;
+  random_state_ ^= random_state_ >> 17;
+  random_state_ ^= random_state_ << 5;
+  return random_state_;
+}
@@ -0,0 +1,77 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_GENERATED_VIDEO_SOURCE_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_GENERATED_VIDEO_SOURCE_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "api/scoped_refptr.h"
+#include "api/video/i420_buffer.h"
+#include "api/video/video_frame_buffer.h"
+#include "common_video/include/video_frame_buffer_pool.h"
+#include "examples/headless_peerconnection/client/paced_video_source.h"
+
+struct VideoGeneratorOptions {
+  enum Pattern {
+    // A diagonal ramp that moves every frame.
+    kGradient,
+    // Random luma, differently placed every frame.
+    kNoise,
+    // The frame number as a row of 32 black or white blocks along the top,
+    // most significant bit first, on a black frame.
+    kCounter,
+  };
+
+  Pattern pattern = kGradient;
+  int width = 640;
+  int height = 480;
+  int fps = 30;
+};
+
+// Parses "gradient", "noise" or "counter".
+bool ParseVideoPattern(absl::string_view name,
+                       VideoGeneratorOptions::Pattern* pattern);
+
+// Local video drawn by the client itself, for load tests that don't care
+// what's in the picture.  Frames are drawn into buffers recycled through a
+// pool, and each pattern is copied row by row out of a block of pixels made
+// once, so a frame costs little more than a memcpy of it.
+class GeneratedVideoTrackSource : public PacedVideoTrackSource {
+ public:
+  // Returns null if the size or frame rate isn't positive.
+  static rtc::scoped_refptr<GeneratedVideoTrackSource> Create(
+      const VideoGeneratorOptions& options);
+
+ protected:
+  explicit GeneratedVideoTrackSource(const VideoGeneratorOptions& options);
+  ~GeneratedVideoTrackSource() override;
+
+ private:
+  rtc::scoped_refptr<webrtc::VideoFrameBuffer> NextFrame(
+      int64_t index) override;
+
+  void DrawGradient(int64_t index, webrtc::I420Buffer* buffer);
+  void DrawNoise(webrtc::I420Buffer* buffer);
+  void DrawCounter(int64_t index, webrtc::I420Buffer* buffer);
+  uint32_t NextRandom();
+
+  const VideoGeneratorOptions options_;
+  webrtc::VideoFrameBufferPool pool_;
+  // The rows the luma of the pattern is copied out of.
+  std::vector<uint8_t> pattern_;
+  size_t pattern_stride_;
+  uint32_t random_state_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_GENERATED_VIDEO_SOURCE_H_
@@ -10,6 +10,9 @@
 
 #include "examples/headless_peerconnection/client/headless_peer_connection_client.h"
 
+#include <utility>
+
+#include "absl/strings/numbers.h"
 #include "api/units/time_delta.h"
 #include "examples/headless_peerconnection/client/defaults.h"
 #include "rtc_base/async_dns_resolver.h"
@@ -17,13 +20,34 @@
 #include "rtc_base/logging.h"
 #include "rtc_base/net_helpers.h"
 #include "rtc_base/thread.h"
+#include "rtc_base/time_utils.h"
 
 namespace {
 
 // This is our magical hangup signal.
 constexpr char kByeMessage[] = "BYE";
-// Delay between server connection retries, in milliseconds
-constexpr webrtc::TimeDelta kReconnectDelay = webrtc::TimeDelta::Seconds(2);
+// See comment in peer_channel.cc for the member list paging headers.
+constexpr char kMemberVersionHeader[] = "X-Member-Version";
+constexpr char kMemberNextHeader[] = "X-Member-Next";
+// Asks the server to keep the control connection open between requests.
+constexpr char kKeepAliveHeader[] = "Connection: keep-alive\r\n";
+// Asks the server to stream notifications over one hanging GET.  See the
+// comment in peer_channel.cc.
+constexpr char kStreamArgument[] = "stream=1";
+// How long resolved server addresses are reused for.
+constexpr webrtc::TimeDelta kDnsCacheTtl = webrtc::TimeDelta::Seconds(60);
+// Head start the preferred address family gets when signing in, before the
+// other one is tried as well (RFC 8305 recommends 250 ms).
+constexpr webrtc::TimeDelta kConnectionAttemptDelay =
+    webrtc::TimeDelta::Millis(250);
+// The first clock samples after signing in are taken in quick succession to
+// get a usable offset soon.  Later ones track drift and keep the best sample
+// in the estimator's window recent.
+constexpr int kInitialClockSamples = 8;
+constexpr webrtc::TimeDelta kInitialClockSampleInterval =
+    webrtc::TimeDelta::Millis(100);
+constexpr webrtc::TimeDelta kClockSampleInterval =
+    webrtc::TimeDelta::Seconds(5);
 
 rtc::Socket* CreateClientSocket(int family) {
   rtc::Thread* thread = rtc::Thread::Current();
@@ -34,25 +58,59 @@ rtc::Socket* CreateClientSocket(int family) {
 }  // namespace
 
 PeerConnectionClient::PeerConnectionClient()
-    : callback_(NULL), resolver_(nullptr), state_(NOT_CONNECTED), my_id_(-1) {}
+    : callback_(NULL),
+      timeline_(nullptr),
+      resolver_(nullptr),
+      dns_cache_(kDnsCacheTtl),
+      alternate_tried_(false),
+      sending_message_(false),
+      state_(NOT_CONNECTED),
+      my_id_(-1),
+      member_version_(0),
+      next_member_page_(-1),
+      fetching_members_(false),
+      sampling_clock_(false),
+      clock_sample_due_(false),
+      clock_sample_scheduled_(false),
+      clock_sampling_supported_(true),
+      clock_sample_sent_us_(0) {}
 
 PeerConnectionClient::~PeerConnectionClient() = default;
 
 void PeerConnectionClient::InitSocketSignals() {
+  InitControlSocketSignals();
+  InitHangingGetSignals();
+  InitClockSocketSignals();
+}
+
+void PeerConnectionClient::InitControlSocketSignals() {
   RTC_DCHECK(control_socket_.get() != NULL);
-  RTC_DCHECK(hanging_get_.get() != NULL);
   control_socket_->SignalCloseEvent.connect(this,
                                             &PeerConnectionClient::OnClose);
-  hanging_get_->SignalCloseEvent.connect(this, &PeerConnectionClient::OnClose);
   control_socket_->SignalConnectEvent.connect(this,
                                               &PeerConnectionClient::OnConnect);
+  control_socket_->SignalReadEvent.connect(this, &PeerConnectionClient::OnRead);
+}
+
+void PeerConnectionClient::InitHangingGetSignals() {
+  RTC_DCHECK(hanging_get_.get() != NULL);
+  hanging_get_->SignalCloseEvent.connect(this, &PeerConnectionClient::OnClose);
   hanging_get_->SignalConnectEvent.connect(
       this, &PeerConnectionClient::OnHangingGetConnect);
-  control_socket_->SignalReadEvent.connect(this, &PeerConnectionClient::OnRead);
   hanging_get_->SignalReadEvent.connect(
       this, &PeerConnectionClient::OnHangingGetRead);
 }
 
+void PeerConnectionClient::InitClockSocketSignals() {
+  RTC_DCHECK(clock_socket_.get() != NULL);
+  clock_socket_->SignalCloseEvent.connect(this,
+                                          &PeerConnectionClient::OnClockClose);
+  clock_socket_->SignalConnectEvent.connect(
+      this, &PeerConnectionClient::OnClockConnect);
+  clock_socket_->SignalReadEvent.connect(this,
+                                         &PeerConnectionClient::OnClockRead);
+}
+
 int PeerConnectionClient::id() const {
   return my_id_;
 }
@@ -65,6 +123,13 @@ const Peers& PeerConnectionClient::peers() const {
   return peers_;
 }
 
+void PeerConnectionClient::set_reconnect_policy(
+    const ReconnectPolicy& policy) {
+  connect_backoff_.set_policy(policy);
+  control_backoff_.set_policy(policy);
+  hanging_get_backoff_.set_policy(policy);
+}
+
 void PeerConnectionClient::RegisterObserver(
     PeerConnectionClientObserver* callback) {
   RTC_DCHECK(!callback_);
@@ -94,9 +159,16 @@ void PeerConnectionClient::Connect(const std::string& server,
 
   server_address_.SetIP(server);
   server_address_.SetPort(port);
+  alternate_address_.Clear();
+  server_host_ = server;
   client_name_ = client_name;
 
-  if (server_address_.IsUnresolvedIP()) {
+  ResolverCache::Entry cached;
+  if (server_address_.IsUnresolvedIP() &&
+      dns_cache_.Lookup(server_host_, &cached)) {
+    UseResolvedAddresses(cached);
+    DoConnect();
+  } else if (server_address_.IsUnresolvedIP()) {
     RTC_DCHECK_NE(state_, RESOLVING);
     RTC_DCHECK(!resolver_);
     state_ = RESOLVING;
@@ -116,29 +188,147 @@ void PeerConnectionClient::OnResolveResult(
     state_ = NOT_CONNECTED;
     return;
   }
-  if (!result.GetResolvedAddress(AF_INET, &server_address_)) {
+  ResolverCache::Entry resolved;
+  rtc::SocketAddress address;
+  if (result.GetResolvedAddress(AF_INET, &address))
+    resolved.ipv4 = address.ipaddr();
+  if (result.GetResolvedAddress(AF_INET6, &address))
+    resolved.ipv6 = address.ipaddr();
+  if (resolved.ipv4.IsNil() && resolved.ipv6.IsNil()) {
     callback_->OnServerConnectionFailure();
     resolver_.reset();
     state_ = NOT_CONNECTED;
     return;
   }
+  UseResolvedAddresses(dns_cache_.Store(server_host_, resolved));
   DoConnect();
 }
 
+void PeerConnectionClient::UseResolvedAddresses(
+    const ResolverCache::Entry& entry) {
+  int port = server_address_.port();
+  const rtc::IPAddress* first = &entry.ipv4;
+  const rtc::IPAddress* second = &entry.ipv6;
+  if (first->IsNil() ||
+      (entry.preferred_family == AF_INET6 && !second->IsNil())) {
+    std::swap(first, second);
+  }
+  server_address_ = rtc::SocketAddress(*first, port);
+  if (second->IsNil())
+    alternate_address_.Clear();
+  else
+    alternate_address_ = rtc::SocketAddress(*second, port);
+}
+
 void PeerConnectionClient::DoConnect() {
   control_socket_.reset(CreateClientSocket(server_address_.ipaddr().family()));
   hanging_get_.reset(CreateClientSocket(server_address_.ipaddr().family()));
+  clock_socket_.reset(CreateClientSocket(server_address_.ipaddr().family()));
   InitSocketSignals();
+  racing_socket_.reset();
+  alternate_tried_ = false;
+  // Whatever was in flight on the previous control connection is gone.
+  control_request_.clear();
   char buffer[1024];
-  snprintf(buffer, sizeof(buffer), "GET /sign_in?%s HTTP/1.0\r\n\r\n",
-           client_name_.c_str());
-  onconnect_data_ = buffer;
+  snprintf(buffer, sizeof(buffer), "GET /sign_in?%s HTTP/1.0\r\n%s\r\n",
+           client_name_.c_str(), kKeepAliveHeader);
 
-  bool ret = ConnectControlSocket();
+  bool ret = SendControlRequest(buffer);
   if (ret)
     state_ = SIGNING_IN;
+  if (ret && timeline_)
+    timeline_->MarkSession("sign_in_sent", server_address_.ToString());
   if (!ret) {
     callback_->OnServerConnectionFailure();
+  } else if (!alternate_address_.IsNil()) {
+    // If the preferred address family is slow to connect, the other one
+    // races it.
+    rtc::Thread::Current()->PostDelayedTask(
+        SafeTask(safety_.flag(),
+                 [this] {
+                   if (state_ == SIGNING_IN &&
+                       control_socket_->GetState() ==
+                           rtc::Socket::CS_CONNECTING) {
+                     ConnectAlternate();
+                   }
+                 }),
+        kConnectionAttemptDelay);
+  }
+}
+
+bool PeerConnectionClient::ConnectAlternate() {
+  if (alternate_address_.IsNil() || alternate_tried_)
+    return false;
+  alternate_tried_ = true;
+  RTC_LOG(LS_INFO) << "Trying " << alternate_address_.ToString() << " too";
+  racing_socket_.reset(CreateClientSocket(alternate_address_.family()));
+  racing_socket_->SignalConnectEvent.connect(
+      this, &PeerConnectionClient::OnAlternateConnect);
+  racing_socket_->SignalCloseEvent.connect(
+      this, &PeerConnectionClient::OnAlternateClose);
+  if (racing_socket_->Connect(alternate_address_) == SOCKET_ERROR) {
+    racing_socket_.reset();
+    return false;
+  }
+  return true;
+}
+
+bool PeerConnectionClient::IsAlternateConnecting() const {
+  return racing_socket_ &&
+         racing_socket_->GetState() == rtc::Socket::CS_CONNECTING;
+}
+
+void PeerConnectionClient::OnAlternateConnect(rtc::Socket* socket) {
+  RTC_DCHECK(socket == racing_socket_.get());
+  RTC_LOG(LS_INFO) << alternate_address_.ToString() << " won the race";
+  if (timeline_)
+    timeline_->MarkSession("address_race_won", alternate_address_.ToString());
+  // The other address family is the one to use from now on, for the
+  // hanging GET and clock samples too.
+  socket->SignalConnectEvent.disconnect(this);
+  socket->SignalCloseEvent.disconnect(this);
+  control_socket_ = std::move(racing_socket_);
+  InitControlSocketSignals();
+  std::swap(server_address_, alternate_address_);
+  hanging_get_.reset(CreateClientSocket(server_address_.family()));
+  InitHangingGetSignals();
+  clock_socket_.reset(CreateClientSocket(server_address_.family()));
+  InitClockSocketSignals();
+  dns_cache_.SetPreferredFamily(server_host_, server_address_.family());
+
+  onconnect_data_ = control_request_;
+  OnConnect(control_socket_.get());
+}
+
+void PeerConnectionClient::OnAlternateClose(rtc::Socket* socket, int err) {
+  RTC_LOG(LS_INFO) << alternate_address_.ToString() << " failed: " << err;
+  socket->Close();
+  // If the preferred family failed first, it left this to be retried.
+  if (state_ == SIGNING_IN &&
+      control_socket_->GetState() == rtc::Socket::CS_CLOSED) {
+    RetrySignIn();
+  }
+}
+
+void PeerConnectionClient::RetrySignIn() {
+  webrtc::TimeDelta delay = webrtc::TimeDelta::Zero();
+  if (connect_backoff_.NextDelay(&delay)) {
+    RTC_LOG(LS_WARNING) << "Connection failed; retrying in " << delay.ms()
+                        << " ms";
+    rtc::Thread::Current()->PostDelayedTask(
+        SafeTask(safety_.flag(),
+                 [this] {
+                   if (state_ != NOT_CONNECTED)
+                     DoConnect();
+                 }),
+        delay);
+  } else {
+    RTC_LOG(LS_ERROR) << "Connection failed; giving up after "
+                      << connect_backoff_.attempts() << " retries";
+    // The server may have moved; look it up again next time.
+    dns_cache_.Forget(server_host_);
+    Close();
+    callback_->OnServerConnectionFailure();
   }
 }
 
@@ -147,20 +337,26 @@ bool PeerConnectionClient::SendToPeer(int peer_id, const std::string& message) {
     return false;
 
   RTC_DCHECK(is_connected());
-  RTC_DCHECK(control_socket_->GetState() == rtc::Socket::CS_CLOSED);
+  RTC_DCHECK(!IsSendingMessage());
   if (!is_connected() || peer_id == -1)
     return false;
 
   char headers[1024];
   snprintf(headers, sizeof(headers),
            "POST /message?peer_id=%i&to=%i HTTP/1.0\r\n"
+           "%s"
            "Content-Length: %zu\r\n"
            "Content-Type: text/plain\r\n"
            "\r\n",
-           my_id_, peer_id, message.length());
-  onconnect_data_ = headers;
-  onconnect_data_ += message;
-  return ConnectControlSocket();
+           my_id_, peer_id, kKeepAliveHeader, message.length());
+  std::string request = headers + message;
+  if (!control_request_.empty()) {
+    // A page of the member list is being fetched; the message goes next.
+    pending_message_ = std::move(request);
+    return true;
+  }
+  sending_message_ = true;
+  return SendControlRequest(request);
 }
 
 bool PeerConnectionClient::SendHangUp(int peer_id) {
@@ -168,8 +364,7 @@ bool PeerConnectionClient::SendHangUp(int peer_id) {
 }
 
 bool PeerConnectionClient::IsSendingMessage() {
-  return state_ == CONNECTED &&
-         control_socket_->GetState() != rtc::Socket::CS_CLOSED;
+  return state_ == CONNECTED && (sending_message_ || !pending_message_.empty());
 }
 
 bool PeerConnectionClient::SignOut() {
@@ -178,16 +373,18 @@ bool PeerConnectionClient::SignOut() {
 
   if (hanging_get_->GetState() != rtc::Socket::CS_CLOSED)
     hanging_get_->Close();
+  clock_socket_->Close();
+  pending_message_.clear();
 
-  if (control_socket_->GetState() == rtc::Socket::CS_CLOSED) {
+  if (control_request_.empty()) {
     state_ = SIGNING_OUT;
 
     if (my_id_ != -1) {
       char buffer[1024];
       snprintf(buffer, sizeof(buffer),
-               "GET /sign_out?peer_id=%i HTTP/1.0\r\n\r\n", my_id_);
-      onconnect_data_ = buffer;
-      return ConnectControlSocket();
+               "GET /sign_out?peer_id=%i HTTP/1.0\r\n%s\r\n", my_id_,
+               kKeepAliveHeader);
+      return SendControlRequest(buffer);
     } else {
       // Can occur if the app is closed before we finish connecting.
       return true;
@@ -202,10 +399,29 @@ bool PeerConnectionClient::SignOut() {
 void PeerConnectionClient::Close() {
   control_socket_->Close();
   hanging_get_->Close();
+  clock_socket_->Close();
+  // Close() may run from within a callback of the racing socket.
+  if (racing_socket_)
+    racing_socket_->Close();
   onconnect_data_.clear();
+  control_request_.clear();
+  pending_message_.clear();
+  sending_message_ = false;
+  control_response_.Reset();
+  notification_.Reset();
+  clock_response_.Reset();
   peers_.clear();
   resolver_.reset();
   my_id_ = -1;
+  member_version_ = 0;
+  next_member_page_ = -1;
+  fetching_members_ = false;
+  clock_offset_.Reset();
+  sampling_clock_ = false;
+  clock_sample_due_ = false;
+  clock_sampling_supported_ = true;
+  connect_backoff_.Reset();
+  hanging_get_backoff_.Reset();
   state_ = NOT_CONNECTED;
 }
 
@@ -219,17 +435,161 @@ bool PeerConnectionClient::ConnectControlSocket() {
   return true;
 }
 
+bool PeerConnectionClient::SendControlRequest(const std::string& request) {
+  RTC_DCHECK(control_request_.empty());
+  control_request_ = request;
+  control_backoff_.Reset();
+  control_response_.Clear();
+
+  if (control_socket_->GetState() == rtc::Socket::CS_CONNECTED) {
+    int sent = control_socket_->Send(request.data(), request.length());
+    if (sent == static_cast<int>(request.length()))
+      return true;
+    // The connection is no good anymore; start over on a new one.
+    control_socket_->Close();
+  }
+
+  onconnect_data_ = request;
+  return ConnectControlSocket();
+}
+
+bool PeerConnectionClient::RequestMemberPage() {
+  RTC_DCHECK(is_connected());
+  RTC_DCHECK_NE(next_member_page_, -1);
+  char buffer[1024];
+  snprintf(buffer, sizeof(buffer),
+           "GET /members?peer_id=%i&after=%i HTTP/1.0\r\n%s\r\n", my_id_,
+           next_member_page_, kKeepAliveHeader);
+  fetching_members_ = true;
+  return SendControlRequest(buffer);
+}
+
+void PeerConnectionClient::MaybeSampleClock() {
+  if (state_ != CONNECTED || !clock_sample_due_ || !clock_sampling_supported_ ||
+      sampling_clock_) {
+    return;
+  }
+  char buffer[1024];
+  snprintf(buffer, sizeof(buffer), "GET /time?peer_id=%i HTTP/1.0\r\n%s\r\n",
+           my_id_, kKeepAliveHeader);
+  clock_request_ = buffer;
+  clock_sample_due_ = false;
+  sampling_clock_ = true;
+  clock_response_.Clear();
+
+  if (clock_socket_->GetState() == rtc::Socket::CS_CONNECTED) {
+    clock_sample_sent_us_ = rtc::TimeMicros();
+    int sent =
+        clock_socket_->Send(clock_request_.data(), clock_request_.length());
+    if (sent == static_cast<int>(clock_request_.length()))
+      return;
+    clock_socket_->Close();
+  }
+  if (clock_socket_->Connect(server_address_) == SOCKET_ERROR) {
+    sampling_clock_ = false;
+    ScheduleClockSample(kClockSampleInterval);
+  }
+}
+
+void PeerConnectionClient::ScheduleClockSample(webrtc::TimeDelta delay) {
+  // Only one sample is scheduled at a time, across sign-ins too.
+  if (clock_sample_scheduled_)
+    return;
+  clock_sample_scheduled_ = true;
+  rtc::Thread::Current()->PostDelayedTask(
+      SafeTask(safety_.flag(),
+               [this] {
+                 clock_sample_scheduled_ = false;
+                 clock_sample_due_ = true;
+                 MaybeSampleClock();
+               }),
+      delay);
+}
+
+void PeerConnectionClient::ReadClockSample(const HttpResponseParser& response,
+                                           int64_t received_us) {
+  // "<server received us>,<server sent us>"
+  absl::string_view body = response.body();
+  size_t comma = body.find(',');
+  int64_t server_received_us = 0;
+  int64_t server_sent_us = 0;
+  if (response.status() != 200 || comma == absl::string_view::npos ||
+      !absl::SimpleAtoi(body.substr(0, comma), &server_received_us) ||
+      !absl::SimpleAtoi(body.substr(comma + 1), &server_sent_us)) {
+    RTC_LOG(LS_WARNING) << "The server doesn't answer clock samples; there's "
+                           "no time base shared with other clients.";
+    clock_sampling_supported_ = false;
+    return;
+  }
+
+  clock_offset_.AddSample(clock_sample_sent_us_, server_received_us,
+                          server_sent_us, received_us);
+  if (clock_offset_.samples() == kInitialClockSamples) {
+    int64_t server_us = 0;
+    int64_t uncertainty_us = 0;
+    clock_offset_.ToServerTime(received_us, &server_us, &uncertainty_us);
+    RTC_LOG(LS_INFO) << "Clock offset to the server: "
+                     << server_us - received_us << " us, +-" << uncertainty_us
+                     << " us";
+  }
+  ScheduleClockSample(clock_offset_.samples() < kInitialClockSamples
+                          ? kInitialClockSampleInterval
+                          : kClockSampleInterval);
+}
+
 void PeerConnectionClient::OnConnect(rtc::Socket* socket) {
   RTC_DCHECK(!onconnect_data_.empty());
+  if (racing_socket_) {
+    // The preferred address family won the race.
+    racing_socket_.reset();
+    dns_cache_.SetPreferredFamily(server_host_, server_address_.family());
+  }
   size_t sent = socket->Send(onconnect_data_.c_str(), onconnect_data_.length());
   RTC_DCHECK(sent == onconnect_data_.length());
   onconnect_data_.clear();
 }
 
+void PeerConnectionClient::OnClockConnect(rtc::Socket* socket) {
+  RTC_DCHECK(sampling_clock_);
+  // A clock sample is timed from when it's actually sent.
+  clock_sample_sent_us_ = rtc::TimeMicros();
+  int sent = socket->Send(clock_request_.data(), clock_request_.length());
+  RTC_DCHECK(sent == static_cast<int>(clock_request_.length()));
+}
+
+void PeerConnectionClient::OnClockRead(rtc::Socket* socket) {
+  // Taken before reading, as the time the answer arrived.
+  int64_t received_us = rtc::TimeMicros();
+  if (!ReadIntoBuffer(socket, &clock_response_))
+    return;
+  if (clock_response_.connection_close())
+    socket->Close();
+  if (sampling_clock_) {
+    sampling_clock_ = false;
+    ReadClockSample(clock_response_, received_us);
+  }
+  clock_response_.Clear();
+}
+
+void PeerConnectionClient::OnClockClose(rtc::Socket* socket, int err) {
+  RTC_LOG(LS_INFO) << __FUNCTION__;
+  socket->Close();
+  clock_response_.Reset();
+  // A retried sample would be off by the reconnect; a later one takes its
+  // place instead.
+  if (sampling_clock_) {
+    sampling_clock_ = false;
+    ScheduleClockSample(kInitialClockSampleInterval);
+  }
+}
+
 void PeerConnectionClient::OnHangingGetConnect(rtc::Socket* socket) {
+  // Whatever was left of a notification on the previous connection is lost.
+  notification_.Reset();
   char buffer[1024];
-  snprintf(buffer, sizeof(buffer), "GET /wait?peer_id=%i HTTP/1.0\r\n\r\n",
-           my_id_);
+  snprintf(buffer, sizeof(buffer),
+           "GET /wait?peer_id=%i&%s HTTP/1.1\r\n\r\n", my_id_,
+           kStreamArgument);
   int len = static_cast<int>(strlen(buffer));
   int sent = socket->Send(buffer, len);
   RTC_DCHECK(sent == len);
@@ -245,106 +605,74 @@ void PeerConnectionClient::OnMessageFromPeer(int peer_id,
   }
 }
 
-bool PeerConnectionClient::GetHeaderValue(const std::string& data,
-                                          size_t eoh,
-                                          const char* header_pattern,
-                                          size_t* value) {
-  RTC_DCHECK(value != NULL);
-  size_t found = data.find(header_pattern);
-  if (found != std::string::npos && found < eoh) {
-    *value = atoi(&data[found + strlen(header_pattern)]);
-    return true;
-  }
-  return false;
-}
-
-bool PeerConnectionClient::GetHeaderValue(const std::string& data,
-                                          size_t eoh,
-                                          const char* header_pattern,
-                                          std::string* value) {
-  RTC_DCHECK(value != NULL);
-  size_t found = data.find(header_pattern);
-  if (found != std::string::npos && found < eoh) {
-    size_t begin = found + strlen(header_pattern);
-    size_t end = data.find("\r\n", begin);
-    if (end == std::string::npos)
-      end = eoh;
-    value->assign(data.substr(begin, end - begin));
-    return true;
-  }
-  return false;
-}
-
 bool PeerConnectionClient::ReadIntoBuffer(rtc::Socket* socket,
-                                          std::string* data,
-                                          size_t* content_length) {
+                                          HttpResponseParser* response) {
   char buffer[0xffff];
   do {
     int bytes = socket->Recv(buffer, sizeof(buffer), nullptr);
     if (bytes <= 0)
       break;
-    data->append(buffer, bytes);
+    response->Append(buffer, bytes);
   } while (true);
 
-  bool ret = false;
-  size_t i = data->find("\r\n\r\n");
-  if (i != std::string::npos) {
-    RTC_LOG(LS_INFO) << "Headers received";
-    if (GetHeaderValue(*data, i, "\r\nContent-Length: ", content_length)) {
-      size_t total_response_size = (i + 4) + *content_length;
-      if (data->length() >= total_response_size) {
-        ret = true;
-        std::string should_close;
-        const char kConnection[] = "\r\nConnection: ";
-        if (GetHeaderValue(*data, i, kConnection, &should_close) &&
-            should_close.compare("close") == 0) {
-          socket->Close();
-          // Since we closed the socket, there was no notification delivered
-          // to us.  Compensate by letting ourselves know.
-          OnClose(socket, 0);
-        }
-      } else {
-        // We haven't received everything.  Just continue to accept data.
-      }
-    } else {
-      RTC_LOG(LS_ERROR) << "No content length field specified by the server.";
-    }
+  if (!response->headers_complete())
+    return false;
+
+  RTC_LOG(LS_INFO) << "Headers received";
+  // The chunks of a streamed response are taken one by one as they arrive.
+  if (response->chunked())
+    return true;
+
+  if (!response->has_content_length()) {
+    RTC_LOG(LS_ERROR) << "No content length field specified by the server.";
+    return false;
   }
-  return ret;
+
+  // Until the whole body is in, just continue to accept data.
+  return response->complete();
 }
 
 void PeerConnectionClient::OnRead(rtc::Socket* socket) {
-  size_t content_length = 0;
-  if (ReadIntoBuffer(socket, &control_data_, &content_length)) {
-    size_t peer_id = 0, eoh = 0;
-    bool ok =
-        ParseServerResponse(control_data_, content_length, &peer_id, &eoh);
-    if (ok) {
+  if (ReadIntoBuffer(socket, &control_response_)) {
+    if (control_response_.connection_close())
+      socket->Close();
+
+    if (control_request_.empty()) {
+      // Nothing was asked for; the server is timing out the idle connection.
+      control_response_.Clear();
+      return;
+    }
+    // A throttled request isn't refused for good; the server's rate limit
+    // lets it through again after a while.
+    if (control_response_.status() == 429 && RetryThrottledRequest()) {
+      control_response_.Clear();
+      return;
+    }
+    control_request_.clear();
+    if (sending_message_) {
+      sending_message_ = false;
+      callback_->OnMessageSent(0);
+    }
+
+    size_t peer_id = 0;
+    if (ParseServerResponse(control_response_, &peer_id)) {
       if (my_id_ == -1) {
         // First response.  Let's store our server assigned ID.
         RTC_DCHECK(state_ == SIGNING_IN);
+        connect_backoff_.Reset();
+        if (timeline_)
+          timeline_->MarkSession("signed_in", std::to_string(peer_id));
         my_id_ = static_cast<int>(peer_id);
         RTC_DCHECK(my_id_ != -1);
 
-        // The body of the response will be a list of already connected peers.
-        if (content_length) {
-          size_t pos = eoh + 4;
-          while (pos < control_data_.size()) {
-            size_t eol = control_data_.find('\n', pos);
-            if (eol == std::string::npos)
-              break;
-            int id = 0;
-            std::string name;
-            bool connected;
-            if (ParseEntry(control_data_.substr(pos, eol - pos), &name, &id,
-                           &connected) &&
-                id != my_id_) {
-              peers_[id] = name;
-              callback_->OnPeerConnected(id, name);
-            }
-            pos = eol + 1;
-          }
-        }
+        // Notifications up to this version are already reflected in the list.
+        size_t version = 0;
+        if (control_response_.GetHeader(kMemberVersionHeader, &version))
+          member_version_ = static_cast<int>(version);
+
+        // The body of the response will be a list of already connected peers,
+        // or the first page of it.
+        ReadMemberPage(control_response_);
         RTC_DCHECK(is_connected());
         callback_->OnSignedIn();
       } else if (state_ == SIGNING_OUT) {
@@ -352,54 +680,89 @@ void PeerConnectionClient::OnRead(rtc::Socket* socket) {
         callback_->OnDisconnected();
       } else if (state_ == SIGNING_OUT_WAITING) {
         SignOut();
+      } else if (fetching_members_) {
+        fetching_members_ = false;
+        ReadMemberPage(control_response_);
       }
     }
 
-    control_data_.clear();
+    control_response_.Clear();
 
     if (state_ == SIGNING_IN) {
       RTC_DCHECK(hanging_get_->GetState() == rtc::Socket::CS_CLOSED);
       state_ = CONNECTED;
       hanging_get_->Connect(server_address_);
+      ScheduleClockSample(webrtc::TimeDelta::Zero());
+    }
+
+    // A message held back by a member list page goes first.  Membership
+    // notifications arrive on the hanging GET in the meantime, so the
+    // remaining pages can be fetched at our leisure.
+    if (state_ == CONNECTED && !pending_message_.empty() &&
+        control_request_.empty()) {
+      sending_message_ = true;
+      SendControlRequest(pending_message_);
+      pending_message_.clear();
+    }
+    if (state_ == CONNECTED && next_member_page_ != -1 && !fetching_members_ &&
+        control_request_.empty()) {
+      RequestMemberPage();
     }
   }
 }
 
+void PeerConnectionClient::ReadMemberPage(const HttpResponseParser& response) {
+  size_t next = 0;
+  if (response.GetHeader(kMemberNextHeader, &next))
+    next_member_page_ = static_cast<int>(next);
+  else
+    next_member_page_ = -1;
+
+  absl::string_view body = response.body();
+  size_t pos = 0;
+  while (pos < body.size()) {
+    size_t eol = body.find('\n', pos);
+    if (eol == absl::string_view::npos)
+      break;
+    int id = 0;
+    std::string name;
+    bool connected;
+    if (ParseEntry(body.substr(pos, eol - pos), &name, &id, &connected) &&
+        id != my_id_ && peers_.find(id) == peers_.end()) {
+      peers_[id] = name;
+      callback_->OnPeerConnected(id, name);
+    }
+    pos = eol + 1;
+  }
+}
+
 void PeerConnectionClient::OnHangingGetRead(rtc::Socket* socket) {
   RTC_LOG(LS_INFO) << __FUNCTION__;
-  size_t content_length = 0;
-  if (ReadIntoBuffer(socket, &notification_data_, &content_length)) {
-    size_t peer_id = 0, eoh = 0;
-    bool ok =
-        ParseServerResponse(notification_data_, content_length, &peer_id, &eoh);
-
-    if (ok) {
-      // Store the position where the body begins.
-      size_t pos = eoh + 4;
-
-      if (my_id_ == static_cast<int>(peer_id)) {
-        // A notification about a new member or a member that just
-        // disconnected.
-        int id = 0;
-        std::string name;
-        bool connected = false;
-        if (ParseEntry(notification_data_.substr(pos), &name, &id,
-                       &connected)) {
-          if (connected) {
-            peers_[id] = name;
-            callback_->OnPeerConnected(id, name);
-          } else {
-            peers_.erase(id);
-            callback_->OnPeerDisconnected(id);
-          }
+  if (ReadIntoBuffer(socket, &notification_)) {
+    hanging_get_backoff_.Reset();
+    if (notification_.chunked()) {
+      // The server streams notifications, each chunk holding a response just
+      // like the one a plain "/wait" request gets.
+      absl::string_view chunk;
+      while (state_ == CONNECTED &&
+             hanging_get_->GetState() != rtc::Socket::CS_CLOSED &&
+             notification_.TakeChunk(&chunk)) {
+        if (chunk.empty()) {
+          // End of the stream; pick up again with a new request.
+          socket->Close();
+          break;
         }
-      } else {
-        OnMessageFromPeer(static_cast<int>(peer_id),
-                          notification_data_.substr(pos));
+        stream_event_.Append(chunk.data(), chunk.size());
+        if (stream_event_.complete())
+          HandleNotification(stream_event_);
+        stream_event_.Reset();
       }
+    } else {
+      if (notification_.connection_close())
+        socket->Close();
+      HandleNotification(notification_);
+      notification_.Clear();
     }
-
-    notification_data_.clear();
   }
 
   if (hanging_get_->GetState() == rtc::Socket::CS_CLOSED &&
@@ -408,7 +771,53 @@ void PeerConnectionClient::OnHangingGetRead(rtc::Socket* socket) {
   }
 }
 
-bool PeerConnectionClient::ParseEntry(const std::string& entry,
+void PeerConnectionClient::HandleNotification(
+    const HttpResponseParser& notification) {
+  size_t peer_id = 0;
+  if (!ParseServerResponse(notification, &peer_id))
+    return;
+
+  absl::string_view body = notification.body();
+
+  if (my_id_ == static_cast<int>(peer_id)) {
+    // A notification about new members or members that just
+    // disconnected.  Servers that page the member list may batch several
+    // changes into one notification, one entry per line.
+    size_t version = 0;
+    bool has_version = notification.GetHeader(kMemberVersionHeader, &version);
+    if (has_version && static_cast<int>(version) <= member_version_) {
+      // Already covered by the member list we got when signing in.
+      body = absl::string_view();
+    } else if (has_version) {
+      member_version_ = static_cast<int>(version);
+    }
+
+    size_t pos = 0;
+    while (pos < body.size()) {
+      size_t eol = body.find('\n', pos);
+      if (eol == absl::string_view::npos)
+        eol = body.size();
+      int id = 0;
+      std::string name;
+      bool connected = false;
+      if (eol > pos &&
+          ParseEntry(body.substr(pos, eol - pos), &name, &id, &connected)) {
+        if (connected) {
+          peers_[id] = name;
+          callback_->OnPeerConnected(id, name);
+        } else {
+          peers_.erase(id);
+          callback_->OnPeerDisconnected(id);
+        }
+      }
+      pos = eol + 1;
+    }
+  } else {
+    OnMessageFromPeer(static_cast<int>(peer_id), std::string(body));
+  }
+}
+
+bool PeerConnectionClient::ParseEntry(absl::string_view entry,
                                       std::string* name,
                                       int* id,
                                       bool* connected) {
@@ -419,46 +828,35 @@ bool PeerConnectionClient::ParseEntry(const std::string& entry,
 
   *connected = false;
   size_t separator = entry.find(',');
-  if (separator != std::string::npos) {
-    *id = atoi(&entry[separator + 1]);
-    name->assign(entry.substr(0, separator));
-    separator = entry.find(',', separator + 1);
-    if (separator != std::string::npos) {
-      *connected = atoi(&entry[separator + 1]) ? true : false;
+  if (separator != absl::string_view::npos) {
+    name->assign(entry.data(), separator);
+    absl::string_view rest = entry.substr(separator + 1);
+    separator = rest.find(',');
+    if (!absl::SimpleAtoi(rest.substr(0, separator), id))
+      *id = 0;
+    int connected_flag = 0;
+    if (separator != absl::string_view::npos &&
+        absl::SimpleAtoi(rest.substr(separator + 1), &connected_flag)) {
+      *connected = connected_flag != 0;
     }
   }
   return !name->empty();
 }
 
-int PeerConnectionClient::GetResponseStatus(const std::string& response) {
-  int status = -1;
-  size_t pos = response.find(' ');
-  if (pos != std::string::npos)
-    status = atoi(&response[pos + 1]);
-  return status;
-}
-
-bool PeerConnectionClient::ParseServerResponse(const std::string& response,
-                                               size_t content_length,
-                                               size_t* peer_id,
-                                               size_t* eoh) {
-  int status = GetResponseStatus(response.c_str());
-  if (status != 200) {
+bool PeerConnectionClient::ParseServerResponse(
+    const HttpResponseParser& response,
+    size_t* peer_id) {
+  if (response.status() != 200) {
     RTC_LOG(LS_ERROR) << "Received error from server";
     Close();
     callback_->OnDisconnected();
     return false;
   }
 
-  *eoh = response.find("\r\n\r\n");
-  RTC_DCHECK(*eoh != std::string::npos);
-  if (*eoh == std::string::npos)
-    return false;
-
   *peer_id = -1;
 
   // See comment in peer_channel.cc for why we use the Pragma header.
-  GetHeaderValue(response, *eoh, "\r\nPragma: ", peer_id);
+  response.GetHeader("Pragma", peer_id);
 
   return true;
 }
@@ -468,27 +866,99 @@ void PeerConnectionClient::OnClose(rtc::Socket* socket, int err) {
 
   socket->Close();
 
+  // While signing in, a failure of the preferred address family hands over
+  // to the other one before anything is retried.
+  if (socket == control_socket_.get() && state_ == SIGNING_IN &&
+      (IsAlternateConnecting() || ConnectAlternate())) {
+    return;
+  }
+
 #ifdef WIN32
   if (err != WSAECONNREFUSED) {
 #else
   if (err != ECONNREFUSED) {
 #endif
     if (socket == hanging_get_.get()) {
-      if (state_ == CONNECTED) {
-        hanging_get_->Close();
-        hanging_get_->Connect(server_address_);
+      if (state_ == CONNECTED && !RetryHangingGet()) {
+        Close();
+        callback_->OnDisconnected();
+      }
+    } else if (!control_request_.empty()) {
+      // The server may close a kept-alive connection at any time, so a
+      // request that was in flight is tried again on a new connection.
+      webrtc::TimeDelta delay = webrtc::TimeDelta::Zero();
+      if (control_backoff_.NextDelay(&delay)) {
+        control_response_.Reset();
+        rtc::Thread::Current()->PostDelayedTask(
+            SafeTask(safety_.flag(), [this, err] { RetryControlRequest(err); }),
+            delay);
+        return;
+      }
+      control_request_.clear();
+      if (sending_message_) {
+        sending_message_ = false;
+        callback_->OnMessageSent(err);
       }
-    } else {
-      callback_->OnMessageSent(err);
     }
   } else {
     if (socket == control_socket_.get()) {
-      RTC_LOG(LS_WARNING) << "Connection refused; retrying in 2 seconds";
-      rtc::Thread::Current()->PostDelayedTask(
-          SafeTask(safety_.flag(), [this] { DoConnect(); }), kReconnectDelay);
-    } else {
+      RetrySignIn();
+    } else if (state_ != CONNECTED || !RetryHangingGet()) {
       Close();
       callback_->OnDisconnected();
     }
   }
 }
+
+bool PeerConnectionClient::RetryHangingGet() {
+  webrtc::TimeDelta delay = webrtc::TimeDelta::Zero();
+  if (!hanging_get_backoff_.NextDelay(&delay)) {
+    RTC_LOG(LS_ERROR) << "Lost the hanging GET; giving up after "
+                      << hanging_get_backoff_.attempts() << " retries";
+    return false;
+  }
+  rtc::Thread::Current()->PostDelayedTask(
+      SafeTask(safety_.flag(),
+               [this] {
+                 if (state_ == CONNECTED &&
+                     hanging_get_->GetState() == rtc::Socket::CS_CLOSED) {
+                   hanging_get_->Connect(server_address_);
+                 }
+               }),
+      delay);
+  return true;
+}
+
+bool PeerConnectionClient::RetryThrottledRequest() {
+  webrtc::TimeDelta delay = webrtc::TimeDelta::Zero();
+  if (!control_backoff_.NextDelay(&delay)) {
+    RTC_LOG(LS_ERROR) << "Still throttled by the server; giving up after "
+                      << control_backoff_.attempts() << " retries";
+    return false;
+  }
+  RTC_LOG(LS_WARNING) << "Throttled by the server; retrying in " << delay.ms()
+                      << " ms";
+  rtc::Thread::Current()->PostDelayedTask(
+      SafeTask(safety_.flag(), [this] { RetryControlRequest(0); }), delay);
+  return true;
+}
+
+void PeerConnectionClient::RetryControlRequest(int err) {
+  // Close() may have dropped the request in the meantime.
+  if (control_request_.empty())
+    return;
+  if (control_socket_->GetState() == rtc::Socket::CS_CONNECTED) {
+    // The server kept the connection of a throttled request open.
+    int sent = control_socket_->Send(control_request_.data(),
+                                     control_request_.length());
+    if (sent == static_cast<int>(control_request_.length()))
+      return;
+    control_socket_->Close();
+  } else if (control_socket_->GetState() != rtc::Socket::CS_CLOSED) {
+    return;
+  }
+  onconnect_data_ = control_request_;
+  bool message = sending_message_;
+  if (!ConnectControlSocket() && message)
+    callback_->OnMessageSent(err);
+}
@@ -15,8 +15,14 @@
 #include <memory>
 #include <string>
 
+#include "absl/strings/string_view.h"
 #include "api/async_dns_resolver.h"
 #include "api/task_queue/pending_task_safety_flag.h"
+#include "examples/headless_peerconnection/client/clock_offset_estimator.h"
+#include "examples/headless_peerconnection/client/http_response_parser.h"
+#include "examples/headless_peerconnection/client/reconnect_backoff.h"
+#include "examples/headless_peerconnection/client/resolver_cache.h"
+#include "examples/headless_peerconnection/client/signaling_timeline.h"
 #include "rtc_base/net_helpers.h"
 #include "rtc_base/physical_socket_server.h"
 #include "rtc_base/third_party/sigslot/sigslot.h"
@@ -54,8 +60,18 @@ class PeerConnectionClient : public sigslot::has_slots<> {
   bool is_connected() const;
   const Peers& peers() const;
 
+  // Applies to connections made from now on.
+  void set_reconnect_policy(const ReconnectPolicy& policy);
+
   void RegisterObserver(PeerConnectionClientObserver* callback);
 
+  // Sign-in milestones are marked on `timeline`, if set.
+  void set_timeline(SignalingTimeline* timeline) { timeline_ = timeline; }
+
+  // The offset of our clock to the server's, which serves as a time base
+  // shared with the other clients.  Sampled while signed in.
+  const ClockOffsetEstimator& clock_offset() const { return clock_offset_; }
+
   void Connect(const std::string& server,
                int port,
                const std::string& client_name);
@@ -70,60 +86,134 @@ class PeerConnectionClient : public sigslot::has_slots<> {
   void DoConnect();
   void Close();
   void InitSocketSignals();
+  void InitControlSocketSignals();
+  void InitHangingGetSignals();
+  void InitClockSocketSignals();
+  // Orders the addresses of the server by the family preferred for it.
+  void UseResolvedAddresses(const ResolverCache::Entry& entry);
+  // Starts connecting to `alternate_address_` for the sign-in, unless that
+  // was done already.  Returns true if the connection is under way.
+  bool ConnectAlternate();
+  bool IsAlternateConnecting() const;
+  void OnAlternateConnect(rtc::Socket* socket);
+  void OnAlternateClose(rtc::Socket* socket, int err);
+  // Signs in again after the delay the backoff calls for, or gives up.
+  void RetrySignIn();
   bool ConnectControlSocket();
+  // Sends `request` on the keep-alive control connection, connecting it
+  // first if the server has closed it since the last request.
+  bool SendControlRequest(const std::string& request);
+  // Asks the server for the page of the member list that follows
+  // `next_member_page_`.
+  bool RequestMemberPage();
+  // Asks the server for its time on the clock connection if a sample is due
+  // and none is in flight.
+  void MaybeSampleClock();
+  // Makes a clock sample due after `delay`.
+  void ScheduleClockSample(webrtc::TimeDelta delay);
+  void ReadClockSample(const HttpResponseParser& response,
+                       int64_t received_us);
   void OnConnect(rtc::Socket* socket);
+  void OnClockConnect(rtc::Socket* socket);
+  void OnClockRead(rtc::Socket* socket);
+  void OnClockClose(rtc::Socket* socket, int err);
   void OnHangingGetConnect(rtc::Socket* socket);
   void OnMessageFromPeer(int peer_id, const std::string& message);
 
-  // Quick and dirty support for parsing HTTP header values.
-  bool GetHeaderValue(const std::string& data,
-                      size_t eoh,
-                      const char* header_pattern,
-                      size_t* value);
-
-  bool GetHeaderValue(const std::string& data,
-                      size_t eoh,
-                      const char* header_pattern,
-                      std::string* value);
-
-  // Returns true if the whole response has been read.
-  bool ReadIntoBuffer(rtc::Socket* socket,
-                      std::string* data,
-                      size_t* content_length);
+  // Returns true if the whole response has been read into `response`, or
+  // the headers of a chunked one.
+  bool ReadIntoBuffer(rtc::Socket* socket, HttpResponseParser* response);
 
   void OnRead(rtc::Socket* socket);
 
   void OnHangingGetRead(rtc::Socket* socket);
 
+  // Handles a complete "/wait" response: a membership change or a message
+  // from a peer.
+  void HandleNotification(const HttpResponseParser& notification);
+
   // Parses a single line entry in the form "<name>,<id>,<connected>"
-  bool ParseEntry(const std::string& entry,
+  bool ParseEntry(absl::string_view entry,
                   std::string* name,
                   int* id,
                   bool* connected);
 
-  int GetResponseStatus(const std::string& response);
+  // Adds the peers listed in a sign-in or "/members" response body and
+  // remembers whether the server has more pages for us.
+  void ReadMemberPage(const HttpResponseParser& response);
 
-  bool ParseServerResponse(const std::string& response,
-                           size_t content_length,
-                           size_t* peer_id,
-                           size_t* eoh);
+  bool ParseServerResponse(const HttpResponseParser& response,
+                           size_t* peer_id);
 
   void OnClose(rtc::Socket* socket, int err);
 
+  // Schedules a new hanging GET after the delay the backoff calls for.
+  // Returns false once the retry budget is used up.
+  bool RetryHangingGet();
+  // Sends the pending control request again after the server answered it
+  // with "429 Too Many Requests".  Returns false once the retry budget is
+  // used up.
+  bool RetryThrottledRequest();
+  // Sends the pending control request again, on a new connection unless the
+  // current one is still open.
+  void RetryControlRequest(int err);
+
   void OnResolveResult(const webrtc::AsyncDnsResolverResult& result);
 
   PeerConnectionClientObserver* callback_;
+  SignalingTimeline* timeline_;
   rtc::SocketAddress server_address_;
+  // The server's address in the other family, if it has one.  The sign-in
+  // connects to it as well if `server_address_` is slow or fails.
+  rtc::SocketAddress alternate_address_;
+  std::string server_host_;
   std::unique_ptr<webrtc::AsyncDnsResolverInterface> resolver_;
+  ResolverCache dns_cache_;
+  // The sign-in connection to `alternate_address_`.
+  std::unique_ptr<rtc::Socket> racing_socket_;
+  bool alternate_tried_;
   std::unique_ptr<rtc::Socket> control_socket_;
   std::unique_ptr<rtc::Socket> hanging_get_;
+  // Clock samples have a connection of their own, so that they neither wait
+  // for signaling nor hold it up.
+  std::unique_ptr<rtc::Socket> clock_socket_;
   std::string onconnect_data_;
-  std::string control_data_;
-  std::string notification_data_;
+  // The request awaiting a response on the control connection, kept so that
+  // it can be sent again if the connection drops before the response.
+  std::string control_request_;
+  // `control_request_` is a "/message", whose response OnMessageSent()
+  // reports.
+  bool sending_message_;
+  // A "/message" request waiting for a member list page to come back.
+  std::string pending_message_;
+  // Retries of signing in, of the pending control request and of the
+  // hanging GET are each counted against the reconnect policy on their own.
+  ReconnectBackoff connect_backoff_;
+  ReconnectBackoff control_backoff_;
+  ReconnectBackoff hanging_get_backoff_;
+  HttpResponseParser control_response_;
+  HttpResponseParser notification_;
+  // The notification in the current chunk of a streamed "/wait" response.
+  HttpResponseParser stream_event_;
   std::string client_name_;
   Peers peers_;
   State state_;
   int my_id_;
+  // Member list version the peers we know of are up to date with.
+  int member_version_;
+  // Cursor of the next member list page to fetch, or -1 if we have them all.
+  int next_member_page_;
+  bool fetching_members_;
+  ClockOffsetEstimator clock_offset_;
+  std::string clock_request_;
+  HttpResponseParser clock_response_;
+  // A "/time" request is in flight on the clock connection.
+  bool sampling_clock_;
+  bool clock_sample_due_;
+  bool clock_sample_scheduled_;
+  // Cleared if the server doesn't know "/time".
+  bool clock_sampling_supported_;
+  int64_t clock_sample_sent_us_;
   webrtc::ScopedTaskSafety safety_;
 };
 
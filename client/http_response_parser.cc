@@ -0,0 +1,199 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/http_response_parser.h"
+
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+
+namespace {
+
+constexpr char kHeaderTerminator[] = "\r\n\r\n";
+constexpr size_t kHeaderTerminatorLength = sizeof(kHeaderTerminator) - 1;
+constexpr char kLineTerminator[] = "\r\n";
+constexpr size_t kLineTerminatorLength = sizeof(kLineTerminator) - 1;
+
+}  // namespace
+
+HttpResponseParser::HttpResponseParser()
+    : scanned_(0),
+      headers_complete_(false),
+      body_begin_(0),
+      status_(-1),
+      has_content_length_(false),
+      content_length_(0),
+      chunked_(false),
+      next_chunk_(0) {}
+
+HttpResponseParser::~HttpResponseParser() = default;
+
+bool HttpResponseParser::Append(const char* data, size_t length) {
+  DiscardTakenChunks();
+  buffer_.append(data, length);
+  return Parse();
+}
+
+bool HttpResponseParser::complete() const {
+  return headers_complete_ && has_content_length_ &&
+         buffer_.size() - body_begin_ >= content_length_;
+}
+
+absl::string_view HttpResponseParser::body() const {
+  if (!headers_complete_)
+    return absl::string_view();
+  size_t length = buffer_.size() - body_begin_;
+  if (has_content_length_ && length > content_length_)
+    length = content_length_;
+  return absl::string_view(buffer_).substr(body_begin_, length);
+}
+
+bool HttpResponseParser::GetHeader(absl::string_view name,
+                                   absl::string_view* value) const {
+  absl::string_view buffer(buffer_);
+  for (const Header& header : headers_) {
+    if (absl::EqualsIgnoreCase(
+            buffer.substr(header.name_begin, header.name_length), name)) {
+      *value = buffer.substr(header.value_begin, header.value_length);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HttpResponseParser::GetHeader(absl::string_view name,
+                                   size_t* value) const {
+  absl::string_view text;
+  return GetHeader(name, &text) && absl::SimpleAtoi(text, value);
+}
+
+bool HttpResponseParser::connection_close() const {
+  absl::string_view value;
+  return GetHeader("Connection", &value) &&
+         absl::EqualsIgnoreCase(value, "close");
+}
+
+bool HttpResponseParser::TakeChunk(absl::string_view* chunk) {
+  if (!chunked_)
+    return false;
+
+  absl::string_view buffer(buffer_);
+  size_t size_end = buffer.find(kLineTerminator, next_chunk_);
+  if (size_end == absl::string_view::npos)
+    return false;
+
+  // "<hex size>[;extensions]\r\n<data>\r\n"
+  absl::string_view size_text =
+      buffer.substr(next_chunk_, size_end - next_chunk_);
+  size_text = size_text.substr(0, size_text.find(';'));
+  size_t size = 0;
+  if (!absl::SimpleHexAtoi(size_text, &size)) {
+    *chunk = absl::string_view();
+    return true;
+  }
+
+  size_t data_begin = size_end + kLineTerminatorLength;
+  size_t available = buffer.size() - data_begin;
+  if (available < kLineTerminatorLength ||
+      available - kLineTerminatorLength < size) {
+    return false;
+  }
+
+  *chunk = buffer.substr(data_begin, size);
+  next_chunk_ = data_begin + size + kLineTerminatorLength;
+  return true;
+}
+
+void HttpResponseParser::Clear() {
+  size_t consumed = buffer_.size();
+  if (complete())
+    consumed = body_begin_ + content_length_;
+  buffer_.erase(0, consumed);
+  scanned_ = 0;
+  headers_complete_ = false;
+  body_begin_ = 0;
+  status_ = -1;
+  has_content_length_ = false;
+  content_length_ = 0;
+  chunked_ = false;
+  next_chunk_ = 0;
+  headers_.clear();
+  if (!buffer_.empty())
+    Parse();
+}
+
+void HttpResponseParser::Reset() {
+  buffer_.clear();
+  Clear();
+}
+
+void HttpResponseParser::DiscardTakenChunks() {
+  // Called before the buffer grows, so views handed out stay valid until
+  // then.  The headers in front of the body are kept.
+  if (next_chunk_ > body_begin_) {
+    buffer_.erase(body_begin_, next_chunk_ - body_begin_);
+    next_chunk_ = body_begin_;
+  }
+}
+
+bool HttpResponseParser::Parse() {
+  if (headers_complete_)
+    return true;
+
+  // The terminator may straddle the bytes scanned before and the new ones.
+  size_t from = scanned_ > kHeaderTerminatorLength - 1
+                    ? scanned_ - (kHeaderTerminatorLength - 1)
+                    : 0;
+  size_t end_of_headers = buffer_.find(kHeaderTerminator, from);
+  if (end_of_headers == std::string::npos) {
+    scanned_ = buffer_.size();
+    return true;
+  }
+  scanned_ = end_of_headers + kHeaderTerminatorLength;
+  return ParseHeaders(end_of_headers);
+}
+
+bool HttpResponseParser::ParseHeaders(size_t end_of_headers) {
+  absl::string_view buffer(buffer_);
+  headers_complete_ = true;
+  body_begin_ = end_of_headers + kHeaderTerminatorLength;
+
+  // Status line: "HTTP/1.1 200 OK".
+  size_t line_end = buffer.find("\r\n");
+  absl::string_view status_line = buffer.substr(0, line_end);
+  size_t space = status_line.find(' ');
+  if (space == absl::string_view::npos)
+    return false;
+  absl::string_view code = status_line.substr(space + 1, 3);
+  if (!absl::SimpleAtoi(code, &status_))
+    return false;
+
+  size_t pos = line_end + 2;
+  while (pos < end_of_headers) {
+    line_end = buffer.find("\r\n", pos);
+    if (line_end == absl::string_view::npos || line_end > end_of_headers)
+      line_end = end_of_headers;
+    size_t colon = buffer.find(':', pos);
+    if (colon != absl::string_view::npos && colon < line_end) {
+      size_t value_begin = colon + 1;
+      while (value_begin < line_end && buffer[value_begin] == ' ')
+        ++value_begin;
+      headers_.push_back(
+          {pos, colon - pos, value_begin, line_end - value_begin});
+    }
+    pos = line_end + 2;
+  }
+
+  has_content_length_ = GetHeader("Content-Length", &content_length_);
+  absl::string_view transfer_encoding;
+  chunked_ = GetHeader("Transfer-Encoding", &transfer_encoding) &&
+             absl::EqualsIgnoreCase(transfer_encoding, "chunked");
+  next_chunk_ = body_begin_;
+  return true;
+}
@@ -0,0 +1,99 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_HTTP_RESPONSE_PARSER_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_HTTP_RESPONSE_PARSER_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+
+// Collects an HTTP response as it arrives on a connection.  Only the bytes
+// added since the last call are scanned for the end of the headers, and the
+// headers are split up once, when they're complete.  Headers and body are
+// handed out as views into the parser's buffer, which stay valid until the
+// next call to Append() or Clear().
+class HttpResponseParser {
+ public:
+  HttpResponseParser();
+  ~HttpResponseParser();
+
+  // Adds bytes read from the connection.  Returns false if the status line
+  // is malformed.
+  bool Append(const char* data, size_t length);
+
+  bool headers_complete() const { return headers_complete_; }
+
+  // True once the headers and Content-Length bytes of body have arrived.
+  bool complete() const;
+
+  // Valid once the headers are complete.
+  int status() const { return status_; }
+  bool has_content_length() const { return has_content_length_; }
+
+  // The body of a complete response.
+  absl::string_view body() const;
+
+  // Looks up a header by its case-insensitive name.
+  bool GetHeader(absl::string_view name, absl::string_view* value) const;
+  bool GetHeader(absl::string_view name, size_t* value) const;
+
+  // True if the server closes the connection after this response.
+  bool connection_close() const;
+
+  // True if the body is sent with "Transfer-Encoding: chunked".
+  bool chunked() const { return chunked_; }
+
+  // Hands out the next chunk of a chunked body once all of it has arrived.
+  // The view stays valid until the next call to any non-const method.  An
+  // empty chunk marks the end of the body, and is also returned if the
+  // chunk framing is malformed.
+  bool TakeChunk(absl::string_view* chunk);
+
+  // Discards the current response.  Bytes that arrived after it are kept
+  // as the start of the next one.
+  void Clear();
+
+  // Discards everything, for reuse on a new connection.
+  void Reset();
+
+ private:
+  struct Header {
+    size_t name_begin;
+    size_t name_length;
+    size_t value_begin;
+    size_t value_length;
+  };
+
+  // Looks for the end of the headers in the bytes not yet scanned and parses
+  // them once they're all in.
+  bool Parse();
+  bool ParseHeaders(size_t end_of_headers);
+  // Drops chunks already handed out by TakeChunk().
+  void DiscardTakenChunks();
+
+  std::string buffer_;
+  // Bytes of `buffer_` already searched for the end of the headers.
+  size_t scanned_;
+  bool headers_complete_;
+  size_t body_begin_;
+  int status_;
+  bool has_content_length_;
+  size_t content_length_;
+  bool chunked_;
+  // Start of the first chunk of the body not yet handed out.
+  size_t next_chunk_;
+  std::vector<Header> headers_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_HTTP_RESPONSE_PARSER_H_
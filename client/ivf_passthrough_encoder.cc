@@ -0,0 +1,326 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/ivf_passthrough_encoder.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <utility>
+
+#include "absl/strings/match.h"
+#include "api/video/encoded_image.h"
+#include "api/video/video_frame_type.h"
+#include "api/video_codecs/video_codec.h"
+#include "modules/video_coding/codecs/interface/common_constants.h"
+#include "modules/video_coding/include/video_codec_interface.h"
+#include "modules/video_coding/include/video_error_codes.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+namespace {
+
+const size_t kIvfFileHeaderSize = 32;
+const size_t kIvfFrameHeaderSize = 12;
+// RTP clock rate of video.
+const int64_t kRtpTicksPerSec = 90000;
+// Further behind than this, playback starts over at the next key frame
+// instead of catching up.
+const int64_t kMaxLagUs = rtc::kNumMicrosecsPerSec;
+
+uint16_t ReadLe16(const uint8_t* data) {
+  return data[0] | (data[1] << 8);
+}
+
+uint32_t ReadLe32(const uint8_t* data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) |
+         (static_cast<uint32_t>(data[3]) << 24);
+}
+
+uint64_t ReadLe64(const uint8_t* data) {
+  return ReadLe32(data) | (static_cast<uint64_t>(ReadLe32(data + 4)) << 32);
+}
+
+bool IsVp8KeyFrame(const uint8_t* data, size_t size) {
+  // The lowest bit of the frame tag is 0 for key frames.
+  return size > 0 && (data[0] & 0x01) == 0;
+}
+
+bool IsVp9KeyFrame(const uint8_t* data, size_t size) {
+  if (size == 0)
+    return false;
+  // Uncompressed header, most significant bit first: frame_marker(2),
+  // profile_low_bit, profile_high_bit, reserved_zero if profile 3,
+  // show_existing_frame, frame_type (0 for a key frame).
+  int bit = 2;
+  int profile = ((data[0] >> 5) & 1) | (((data[0] >> 4) & 1) << 1);
+  bit += 2;
+  if (profile == 3)
+    ++bit;
+  if ((data[0] >> (7 - bit)) & 1)
+    return false;  // show_existing_frame
+  ++bit;
+  return ((data[0] >> (7 - bit)) & 1) == 0;
+}
+
+}  // namespace
+
+rtc::scoped_refptr<IvfFile> IvfFile::Load(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    RTC_LOG(LS_ERROR) << "Failed to open IVF file: " << path;
+    return nullptr;
+  }
+  auto ivf = rtc::make_ref_counted<IvfFile>();
+  uint8_t buffer[64 * 1024];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    ivf->contents_.insert(ivf->contents_.end(), buffer, buffer + read);
+  fclose(file);
+  if (!ivf->Parse()) {
+    RTC_LOG(LS_ERROR) << "Unsupported or malformed IVF file: " << path;
+    return nullptr;
+  }
+  RTC_LOG(LS_INFO) << "Passing through " << ivf->frames_.size() << " "
+                   << webrtc::CodecTypeToPayloadString(ivf->codec_type_)
+                   << " frames of " << ivf->width_ << "x" << ivf->height_
+                   << " from " << path;
+  return ivf;
+}
+
+int IvfFile::fps() const {
+  if (frames_.size() < 2)
+    return 30;
+  int64_t duration_us = frames_.back().timestamp_us - frames_[0].timestamp_us;
+  if (duration_us <= 0)
+    return 30;
+  int64_t intervals = frames_.size() - 1;
+  return static_cast<int>((intervals * rtc::kNumMicrosecsPerSec +
+                           duration_us - 1) / duration_us);
+}
+
+bool IvfFile::Parse() {
+  const uint8_t* data = contents_.data();
+  if (contents_.size() < kIvfFileHeaderSize || memcmp(data, "DKIF", 4) != 0)
+    return false;
+  size_t header_size = ReadLe16(data + 6);
+  if (memcmp(data + 8, "VP80", 4) == 0) {
+    codec_type_ = webrtc::kVideoCodecVP8;
+  } else if (memcmp(data + 8, "VP90", 4) == 0) {
+    codec_type_ = webrtc::kVideoCodecVP9;
+  } else {
+    return false;
+  }
+  width_ = ReadLe16(data + 12);
+  height_ = ReadLe16(data + 14);
+  // Timestamps count in units of numerator / denominator seconds.
+  int64_t denominator = ReadLe32(data + 16);
+  int64_t numerator = ReadLe32(data + 20);
+  if (denominator == 0 || numerator == 0 || header_size < kIvfFileHeaderSize ||
+      header_size > contents_.size()) {
+    return false;
+  }
+
+  size_t pos = header_size;
+  while (contents_.size() - pos >= kIvfFrameHeaderSize) {
+    size_t size = ReadLe32(data + pos);
+    int64_t timestamp = static_cast<int64_t>(ReadLe64(data + pos + 4));
+    pos += kIvfFrameHeaderSize;
+    if (contents_.size() - pos < size)
+      break;  // A truncated last frame is left out.
+    bool key_frame = codec_type_ == webrtc::kVideoCodecVP8
+                         ? IsVp8KeyFrame(data + pos, size)
+                         : IsVp9KeyFrame(data + pos, size);
+    frames_.push_back({pos, size,
+                       timestamp * numerator * rtc::kNumMicrosecsPerSec /
+                           denominator,
+                       key_frame});
+    pos += size;
+  }
+  return !frames_.empty() && frames_[0].key_frame;
+}
+
+IvfPassthroughEncoder::IvfPassthroughEncoder(rtc::scoped_refptr<IvfFile> file)
+    : file_(std::move(file)),
+      callback_(nullptr),
+      next_frame_(0),
+      play_offset_us_(-1),
+      key_frame_needed_(true) {}
+
+IvfPassthroughEncoder::~IvfPassthroughEncoder() = default;
+
+int IvfPassthroughEncoder::InitEncode(const webrtc::VideoCodec* codec_settings,
+                                      const VideoEncoder::Settings& settings) {
+  next_frame_ = 0;
+  play_offset_us_ = -1;
+  key_frame_needed_ = true;
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t IvfPassthroughEncoder::RegisterEncodeCompleteCallback(
+    webrtc::EncodedImageCallback* callback) {
+  callback_ = callback;
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t IvfPassthroughEncoder::Release() {
+  callback_ = nullptr;
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t IvfPassthroughEncoder::Encode(
+    const webrtc::VideoFrame& frame,
+    const std::vector<webrtc::VideoFrameType>* frame_types) {
+  if (!callback_)
+    return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+  if (frame_types) {
+    for (webrtc::VideoFrameType type : *frame_types) {
+      if (type == webrtc::VideoFrameType::kVideoFrameKey)
+        key_frame_needed_ = true;
+    }
+  }
+  if (key_frame_needed_) {
+    SkipToKeyFrame();
+    key_frame_needed_ = false;
+    play_offset_us_ = -1;
+  }
+
+  const std::vector<IvfFile::Frame>& frames = file_->frames();
+  int64_t now_us = rtc::TimeMicros();
+  if (play_offset_us_ < 0)
+    play_offset_us_ = now_us - frames[next_frame_].timestamp_us;
+  if (now_us - DueUs(next_frame_) > kMaxLagUs) {
+    SkipToKeyFrame();
+    play_offset_us_ = now_us - frames[next_frame_].timestamp_us;
+  }
+
+  // A late input releases every frame that has come due since the last one,
+  // so that playback doesn't slip.  Frames before a key frame aren't needed
+  // to decode it, so the release starts at the last key frame that's due.
+  std::vector<std::pair<size_t, int64_t>> due;
+  while (DueUs(next_frame_) <= now_us && due.size() < frames.size()) {
+    if (frames[next_frame_].key_frame)
+      due.clear();
+    due.push_back(std::make_pair(next_frame_, DueUs(next_frame_)));
+    Advance();
+  }
+  // Each frame gets the RTP timestamp of when it was due.  It's still later
+  // than that of the last frame released, which was due before that input.
+  for (const auto& release : due) {
+    int64_t late_us = now_us - release.second;
+    SendFrame(frames[release.first], frame,
+              frame.rtp_timestamp() -
+                  static_cast<uint32_t>(late_us * kRtpTicksPerSec /
+                                        rtc::kNumMicrosecsPerSec),
+              frame.render_time_ms() - late_us / rtc::kNumMicrosecsPerMillisec);
+  }
+  return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int64_t IvfPassthroughEncoder::DueUs(size_t index) const {
+  return file_->frames()[index].timestamp_us + play_offset_us_;
+}
+
+void IvfPassthroughEncoder::Advance() {
+  const std::vector<IvfFile::Frame>& frames = file_->frames();
+  ++next_frame_;
+  if (next_frame_ == frames.size()) {
+    // Loop back to the start one frame interval after the last frame.
+    int64_t last_due_us = frames.back().timestamp_us + play_offset_us_;
+    next_frame_ = 0;
+    play_offset_us_ = last_due_us + rtc::kNumMicrosecsPerSec / file_->fps() -
+                      frames[0].timestamp_us;
+  }
+}
+
+void IvfPassthroughEncoder::SendFrame(const IvfFile::Frame& next,
+                                      const webrtc::VideoFrame& input,
+                                      uint32_t rtp_timestamp,
+                                      int64_t capture_time_ms) {
+  webrtc::EncodedImage image;
+  image.SetEncodedData(
+      webrtc::EncodedImageBuffer::Create(file_->data(next), next.size));
+  image._encodedWidth = file_->width();
+  image._encodedHeight = file_->height();
+  image.SetRtpTimestamp(rtp_timestamp);
+  image.capture_time_ms_ = capture_time_ms;
+  image.rotation_ = input.rotation();
+  image._frameType = next.key_frame ? webrtc::VideoFrameType::kVideoFrameKey
+                                    : webrtc::VideoFrameType::kVideoFrameDelta;
+
+  webrtc::CodecSpecificInfo info;
+  info.codecType = file_->codec_type();
+  info.end_of_picture = true;
+  if (info.codecType == webrtc::kVideoCodecVP8) {
+    info.codecSpecific.VP8.nonReference = false;
+    info.codecSpecific.VP8.temporalIdx = webrtc::kNoTemporalIdx;
+    info.codecSpecific.VP8.layerSync = false;
+    info.codecSpecific.VP8.keyIdx = webrtc::kNoKeyIdx;
+  } else {
+    webrtc::CodecSpecificInfoVP9& vp9 = info.codecSpecific.VP9;
+    vp9.first_frame_in_picture = true;
+    vp9.inter_pic_predicted = !next.key_frame;
+    vp9.flexible_mode = false;
+    vp9.ss_data_available = next.key_frame;
+    vp9.non_ref_for_inter_layer_pred = true;
+    vp9.temporal_idx = webrtc::kNoTemporalIdx;
+    vp9.temporal_up_switch = false;
+    vp9.inter_layer_predicted = false;
+    vp9.gof_idx = 0;
+    vp9.num_spatial_layers = 1;
+    vp9.first_active_layer = 0;
+    vp9.spatial_layer_resolution_present = next.key_frame;
+    vp9.width[0] = file_->width();
+    vp9.height[0] = file_->height();
+    vp9.gof.SetGofInfoVP9(webrtc::kTemporalStructureMode1);
+    vp9.num_ref_pics = next.key_frame ? 0 : 1;
+    vp9.p_diff[0] = 1;
+  }
+
+  callback_->OnEncodedImage(image, &info);
+}
+
+webrtc::VideoEncoder::EncoderInfo IvfPassthroughEncoder::GetEncoderInfo()
+    const {
+  EncoderInfo info;
+  info.implementation_name = "IvfPassthrough";
+  info.supports_native_handle = false;
+  info.is_hardware_accelerated = false;
+  info.scaling_settings = VideoEncoder::ScalingSettings::kOff;
+  return info;
+}
+
+void IvfPassthroughEncoder::SkipToKeyFrame() {
+  const std::vector<IvfFile::Frame>& frames = file_->frames();
+  while (!frames[next_frame_].key_frame)
+    next_frame_ = (next_frame_ + 1) % frames.size();
+}
+
+IvfEncoderFactory::IvfEncoderFactory(rtc::scoped_refptr<IvfFile> file)
+    : file_(std::move(file)) {}
+
+IvfEncoderFactory::~IvfEncoderFactory() = default;
+
+std::vector<webrtc::SdpVideoFormat> IvfEncoderFactory::GetSupportedFormats()
+    const {
+  if (file_->codec_type() == webrtc::kVideoCodecVP9)
+    return {webrtc::SdpVideoFormat("VP9", {{"profile-id", "0"}})};
+  return {webrtc::SdpVideoFormat("VP8")};
+}
+
+std::unique_ptr<webrtc::VideoEncoder> IvfEncoderFactory::Create(
+    const webrtc::Environment& env,
+    const webrtc::SdpVideoFormat& format) {
+  if (!absl::EqualsIgnoreCase(
+          format.name, webrtc::CodecTypeToPayloadString(file_->codec_type()))) {
+    return nullptr;
+  }
+  return std::make_unique<IvfPassthroughEncoder>(file_);
+}
@@ -0,0 +1,127 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_IVF_PASSTHROUGH_ENCODER_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_IVF_PASSTHROUGH_ENCODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api/environment/environment.h"
+#include "api/scoped_refptr.h"
+#include "api/video/video_codec_type.h"
+#include "api/video_codecs/sdp_video_format.h"
+#include "api/video_codecs/video_encoder.h"
+#include "api/video_codecs/video_encoder_factory.h"
+#include "rtc_base/ref_count.h"
+
+// A VP8 or VP9 stream in an IVF file, read into memory once and shared by
+// the encoders playing it.
+class IvfFile : public rtc::RefCountInterface {
+ public:
+  struct Frame {
+    size_t offset;
+    size_t size;
+    int64_t timestamp_us;
+    bool key_frame;
+  };
+
+  // Returns null if the file can't be read, isn't VP8 or VP9, or doesn't
+  // start with a key frame.
+  static rtc::scoped_refptr<IvfFile> Load(const std::string& path);
+
+  webrtc::VideoCodecType codec_type() const { return codec_type_; }
+  int width() const { return width_; }
+  int height() const { return height_; }
+  // The average frame rate, rounded up.
+  int fps() const;
+  const std::vector<Frame>& frames() const { return frames_; }
+  const uint8_t* data(const Frame& frame) const {
+    return contents_.data() + frame.offset;
+  }
+
+ private:
+  bool Parse();
+
+  std::vector<uint8_t> contents_;
+  webrtc::VideoCodecType codec_type_ = webrtc::kVideoCodecGeneric;
+  int width_ = 0;
+  int height_ = 0;
+  std::vector<Frame> frames_;
+};
+
+// Sends the frames of an IVF file instead of encoding the frames it's
+// given, so that a sender costs next to nothing beyond packetization.  The
+// frames it's given only set the pace: each one releases the frames of the
+// file that have come due by their IVF timestamps, and is dropped if none
+// has.  A pacing source slower than the file thus gets bursts of frames,
+// and one that stalls for over a second restarts playback at the next key
+// frame.  A key frame request skips ahead to the next key frame in the
+// file.  Bitrate requests are ignored.
+class IvfPassthroughEncoder : public webrtc::VideoEncoder {
+ public:
+  explicit IvfPassthroughEncoder(rtc::scoped_refptr<IvfFile> file);
+  ~IvfPassthroughEncoder() override;
+
+  int InitEncode(const webrtc::VideoCodec* codec_settings,
+                 const VideoEncoder::Settings& settings) override;
+  int32_t RegisterEncodeCompleteCallback(
+      webrtc::EncodedImageCallback* callback) override;
+  int32_t Release() override;
+  int32_t Encode(const webrtc::VideoFrame& frame,
+                 const std::vector<webrtc::VideoFrameType>* frame_types)
+      override;
+  void SetRates(const RateControlParameters& parameters) override {}
+  EncoderInfo GetEncoderInfo() const override;
+
+ private:
+  // Moves `next_frame_` to the first key frame at or after it, wrapping
+  // around to the start of the file.
+  void SkipToKeyFrame();
+  // When frame `index` of the file is due on the rtc::TimeMicros() clock.
+  int64_t DueUs(size_t index) const;
+  // Moves on to the next frame, looping back to the start of the file after
+  // the last one.
+  void Advance();
+  void SendFrame(const IvfFile::Frame& next,
+                 const webrtc::VideoFrame& input,
+                 uint32_t rtp_timestamp,
+                 int64_t capture_time_ms);
+
+  const rtc::scoped_refptr<IvfFile> file_;
+  webrtc::EncodedImageCallback* callback_;
+  size_t next_frame_;
+  // Added to a frame's IVF timestamp to get when it's due, or -1 to restart
+  // the clock with the next frame.
+  int64_t play_offset_us_;
+  bool key_frame_needed_;
+};
+
+// Offers only the codec of an IVF file and creates IvfPassthroughEncoders
+// for it.
+class IvfEncoderFactory : public webrtc::VideoEncoderFactory {
+ public:
+  explicit IvfEncoderFactory(rtc::scoped_refptr<IvfFile> file);
+  ~IvfEncoderFactory() override;
+
+  std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
+  std::unique_ptr<webrtc::VideoEncoder> Create(
+      const webrtc::Environment& env,
+      const webrtc::SdpVideoFormat& format) override;
+
+ private:
+  const rtc::scoped_refptr<IvfFile> file_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_IVF_PASSTHROUGH_ENCODER_H_
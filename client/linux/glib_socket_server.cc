@@ -0,0 +1,143 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/linux/glib_socket_server.h"
+
+#include <stdint.h>
+
+#include "rtc_base/checks.h"
+
+// One descriptor GLib wants polled, watched by the socket server.  What it
+// reports is kept as GLib poll flags until the context checks its sources.
+class GlibSocketServer::PollDispatcher : public rtc::Dispatcher {
+ public:
+  PollDispatcher(GlibSocketServer* server, int fd)
+      : server_(server), fd_(fd), events_(0), revents_(0) {}
+
+  gushort events() const { return events_; }
+  void set_events(gushort events) { events_ = events; }
+  gushort revents() const { return revents_; }
+  void clear_revents() { revents_ = 0; }
+
+  uint32_t GetRequestedEvents() override {
+    // Errors and hangups are reported with reads, so a descriptor GLib only
+    // watches for those is read too.
+    uint32_t requested = 0;
+    if ((events_ & (G_IO_IN | G_IO_PRI)) || !(events_ & G_IO_OUT))
+      requested |= rtc::DE_READ;
+    if (events_ & G_IO_OUT)
+      requested |= rtc::DE_WRITE;
+    return requested;
+  }
+
+  void OnEvent(uint32_t ff, int err) override {
+    if (ff & rtc::DE_READ)
+      revents_ |= G_IO_IN;
+    if (ff & rtc::DE_WRITE)
+      revents_ |= G_IO_OUT;
+    if (ff & rtc::DE_CLOSE)
+      revents_ |= G_IO_IN | G_IO_HUP;
+    if (err)
+      revents_ |= G_IO_ERR;
+    // The sources of this descriptor can only be dispatched once the socket
+    // server stops waiting.
+    server_->WakeUp();
+  }
+
+  int GetDescriptor() override { return fd_; }
+  // Not a socket, so there is nothing to peek; GLib sees the hangup itself.
+  bool IsDescriptorClosed() override { return false; }
+
+ private:
+  GlibSocketServer* const server_;
+  const int fd_;
+  gushort events_;
+  gushort revents_;
+};
+
+GlibSocketServer::GlibSocketServer() : context_(g_main_context_default()) {}
+
+GlibSocketServer::~GlibSocketServer() {
+  for (auto& dispatcher : dispatchers_)
+    Remove(dispatcher.second.get());
+}
+
+bool GlibSocketServer::Wait(webrtc::TimeDelta max_wait_duration,
+                            bool process_io) {
+  if (!process_io)
+    return rtc::PhysicalSocketServer::Wait(max_wait_duration, process_io);
+
+  // Only the thread that runs the message loop calls this, and GTK runs on
+  // it, so the context is always ours to acquire.
+  bool acquired = g_main_context_acquire(context_);
+  RTC_DCHECK(acquired);
+
+  gint priority;
+  bool ready = g_main_context_prepare(context_, &priority);
+  gint timeout_ms;
+  gint count;
+  while ((count = g_main_context_query(
+              context_, priority, &timeout_ms, poll_fds_.data(),
+              static_cast<gint>(poll_fds_.size()))) >
+         static_cast<gint>(poll_fds_.size())) {
+    poll_fds_.resize(count);
+  }
+  poll_fds_.resize(count);
+  UpdateDispatchers();
+
+  webrtc::TimeDelta wait = max_wait_duration;
+  if (ready) {
+    wait = webrtc::TimeDelta::Zero();
+  } else if (timeout_ms >= 0 &&
+             webrtc::TimeDelta::Millis(timeout_ms) < wait) {
+    wait = webrtc::TimeDelta::Millis(timeout_ms);
+  }
+  bool result = rtc::PhysicalSocketServer::Wait(wait, process_io);
+
+  for (GPollFD& poll_fd : poll_fds_) {
+    PollDispatcher* dispatcher = dispatchers_[poll_fd.fd].get();
+    poll_fd.revents = static_cast<gushort>(
+        dispatcher->revents() & (poll_fd.events | G_IO_HUP | G_IO_ERR));
+  }
+  for (auto& dispatcher : dispatchers_)
+    dispatcher.second->clear_revents();
+  if (g_main_context_check(context_, priority, poll_fds_.data(),
+                           static_cast<gint>(poll_fds_.size()))) {
+    g_main_context_dispatch(context_);
+  }
+  g_main_context_release(context_);
+  return result;
+}
+
+void GlibSocketServer::UpdateDispatchers() {
+  std::map<int, gushort> wanted;
+  for (const GPollFD& poll_fd : poll_fds_)
+    wanted[poll_fd.fd] |= poll_fd.events;
+
+  for (auto it = dispatchers_.begin(); it != dispatchers_.end();) {
+    if (wanted.find(it->first) == wanted.end()) {
+      Remove(it->second.get());
+      it = dispatchers_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (const auto& fd : wanted) {
+    std::unique_ptr<PollDispatcher>& dispatcher = dispatchers_[fd.first];
+    if (!dispatcher) {
+      dispatcher = std::make_unique<PollDispatcher>(this, fd.first);
+      dispatcher->set_events(fd.second);
+      Add(dispatcher.get());
+    } else if (dispatcher->events() != fd.second) {
+      dispatcher->set_events(fd.second);
+      Update(dispatcher.get());
+    }
+  }
+}
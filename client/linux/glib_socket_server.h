@@ -0,0 +1,50 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_LINUX_GLIB_SOCKET_SERVER_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_LINUX_GLIB_SOCKET_SERVER_H_
+
+#include <glib.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "api/units/time_delta.h"
+#include "rtc_base/physical_socket_server.h"
+
+// A socket server that also runs the default GLib main context, so that
+// GTK and the rtc::Thread share one loop that blocks until either has
+// something to do.  Each Wait() prepares the context, waits on GLib's file
+// descriptors alongside the sockets for no longer than GLib's next timeout,
+// and then dispatches whatever GLib sources became ready.  Work queued
+// from other threads wakes it either way: rtc::Thread::PostTask through the
+// socket server, g_idle_add() through the context's own wakeup descriptor.
+class GlibSocketServer : public rtc::PhysicalSocketServer {
+ public:
+  GlibSocketServer();
+  ~GlibSocketServer() override;
+
+  bool Wait(webrtc::TimeDelta max_wait_duration, bool process_io) override;
+
+ private:
+  class PollDispatcher;
+
+  // Registers a dispatcher for every descriptor in `poll_fds_`, and removes
+  // the ones GLib no longer polls.
+  void UpdateDispatchers();
+
+  GMainContext* const context_;
+  std::vector<GPollFD> poll_fds_;
+  // GLib may poll a descriptor more than once, epoll only takes it once.
+  std::map<int, std::unique_ptr<PollDispatcher>> dispatchers_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_LINUX_GLIB_SOCKET_SERVER_H_
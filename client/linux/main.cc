@@ -8,25 +8,43 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <stdio.h>
+
+#if !defined(HEADLESS_NULL_WINDOW)
 #include <glib.h>
 #include <gtk/gtk.h>
-#include <stdio.h>
+#endif  // !HEADLESS_NULL_WINDOW
 
+#include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "api/scoped_refptr.h"
 #include "examples/headless_peerconnection/client/conductor.h"
 #include "examples/headless_peerconnection/client/flag_defs.h"
-#include "examples/headless_peerconnection/client/linux/main_wnd.h"
 #include "examples/headless_peerconnection/client/headless_peer_connection_client.h"
+#if defined(HEADLESS_NULL_WINDOW)
+#include "examples/headless_peerconnection/client/null_main_wnd.h"
+#else
+#include "examples/headless_peerconnection/client/linux/glib_socket_server.h"
+#include "examples/headless_peerconnection/client/linux/main_wnd.h"
+#endif  // HEADLESS_NULL_WINDOW
 #include "rtc_base/physical_socket_server.h"
 #include "rtc_base/ssl_adapter.h"
 #include "rtc_base/thread.h"
 #include "system_wrappers/include/field_trial.h"
 #include "test/field_trial.h"
 
-class CustomSocketServer : public rtc::PhysicalSocketServer {
+#if defined(HEADLESS_NULL_WINDOW)
+typedef NullMainWnd MainWnd;
+typedef rtc::PhysicalSocketServer MainSocketServer;
+#else
+typedef GtkMainWnd MainWnd;
+// Runs the GTK loop too.
+typedef GlibSocketServer MainSocketServer;
+#endif  // HEADLESS_NULL_WINDOW
+
+class CustomSocketServer : public MainSocketServer {
  public:
-  explicit CustomSocketServer(GtkMainWnd* wnd)
+  explicit CustomSocketServer(MainWnd* wnd)
       : wnd_(wnd), conductor_(NULL), client_(NULL) {}
   virtual ~CustomSocketServer() {}
 
@@ -35,33 +53,27 @@ class CustomSocketServer : public rtc::PhysicalSocketServer {
   void set_client(PeerConnectionClient* client) { client_ = client; }
   void set_conductor(Conductor* conductor) { conductor_ = conductor; }
 
-  // Override so that we can also pump the GTK message loop.
-  // This function never waits.
+  // Override so that the loop ends once the window is gone and the client
+  // is disconnected.  Otherwise this blocks until there are sockets, GTK
+  // events or messages to handle, or max_wait_duration passes.
   bool Wait(webrtc::TimeDelta max_wait_duration, bool process_io) override {
-    // Pump GTK events.
-    // TODO(henrike): We really should move either the socket server or UI to a
-    // different thread.  Alternatively we could look at merging the two loops
-    // by implementing a dispatcher for the socket server and/or use
-    // g_main_context_set_poll_func.
-    while (gtk_events_pending())
-      gtk_main_iteration();
-
     if (!wnd_->IsWindow() && !conductor_->connection_active() &&
         client_ != NULL && !client_->is_connected()) {
       message_queue_->Quit();
+      return true;
     }
-    return rtc::PhysicalSocketServer::Wait(webrtc::TimeDelta::Zero(),
-                                           process_io);
+    return MainSocketServer::Wait(max_wait_duration, process_io);
   }
 
  protected:
   rtc::Thread* message_queue_;
-  GtkMainWnd* wnd_;
+  MainWnd* wnd_;
   Conductor* conductor_;
   PeerConnectionClient* client_;
 };
 
 int main(int argc, char* argv[]) {
+#if !defined(HEADLESS_NULL_WINDOW)
   gtk_init(&argc, &argv);
 // g_type_init API is deprecated (and does nothing) since glib 2.35.0, see:
 // https://mail.gnome.org/archives/commits-list/2012-November/msg07809.html
@@ -73,6 +85,7 @@ int main(int argc, char* argv[]) {
 #if !GLIB_CHECK_VERSION(2, 31, 0)
   g_thread_init(NULL);
 #endif
+#endif  // !HEADLESS_NULL_WINDOW
 
   absl::ParseCommandLine(argc, argv);
 
@@ -90,18 +103,23 @@ int main(int argc, char* argv[]) {
   }
 
   const std::string server = absl::GetFlag(FLAGS_server);
-  GtkMainWnd wnd(server.c_str(), absl::GetFlag(FLAGS_port),
-                 absl::GetFlag(FLAGS_autoconnect),
-                 absl::GetFlag(FLAGS_autocall));
-  wnd.Create();
+  MainWnd wnd(server.c_str(), absl::GetFlag(FLAGS_port),
+              absl::GetFlag(FLAGS_autoconnect), absl::GetFlag(FLAGS_autocall));
 
   CustomSocketServer socket_server(&wnd);
   rtc::AutoSocketServerThread thread(&socket_server);
+  wnd.Create();
 
   rtc::InitializeSSL();
   // Must be constructed after we set the socketserver.
   PeerConnectionClient client;
   auto conductor = rtc::make_ref_counted<Conductor>(&client, &wnd);
+  if (!ConfigureConductorFromFlags(conductor.get(), &client)) {
+    wnd.Destroy();
+    rtc::CleanupSSL();
+    return -1;
+  }
+  conductor->InitializePeerConnectionFactory();
   conductor->StartStatsThread();
   conductor->StartLegacyStatsThread();
   socket_server.set_client(&client);
@@ -109,15 +127,8 @@ int main(int argc, char* argv[]) {
 
   thread.Run();
 
-  // gtk_main();
   wnd.Destroy();
 
-  // TODO(henrike): Run the Gtk main loop to tear down the connection.
-  /*
-  while (gtk_events_pending()) {
-    gtk_main_iteration();
-  }
-  */
   rtc::CleanupSSL();
   return 0;
 }
@@ -17,6 +17,7 @@
 #include <string>
 #include <vector>
 
+#include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "examples/headless_peerconnection/client/conductor.h"
 #include "examples/headless_peerconnection/client/flag_defs.h"
@@ -107,6 +108,12 @@ int PASCAL wWinMain(HINSTANCE instance,
   rtc::InitializeSSL();
   PeerConnectionClient client;
   auto conductor = rtc::make_ref_counted<Conductor>(&client, &wnd);
+  if (!ConfigureConductorFromFlags(conductor.get(), &client)) {
+    wnd.Destroy();
+    rtc::CleanupSSL();
+    return -1;
+  }
+  conductor->InitializePeerConnectionFactory();
 
   // Main loop.
   MSG msg;
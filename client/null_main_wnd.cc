@@ -0,0 +1,117 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/null_main_wnd.h"
+
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+
+NullMainWnd::NullMainWnd(const char* server,
+                         int port,
+                         bool autoconnect,
+                         bool autocall)
+    : ui_thread_(nullptr),
+      callback_(nullptr),
+      ui_(CONNECT_TO_SERVER),
+      created_(false),
+      login_started_(false),
+      server_(server),
+      port_(port),
+      autoconnect_(autoconnect),
+      autocall_(autocall) {}
+
+NullMainWnd::~NullMainWnd() {
+  RTC_DCHECK(!IsWindow());
+}
+
+void NullMainWnd::RegisterObserver(MainWndCallback* callback) {
+  callback_ = callback;
+}
+
+bool NullMainWnd::IsWindow() {
+  return created_;
+}
+
+bool NullMainWnd::Create() {
+  RTC_DCHECK(!created_);
+  ui_thread_ = rtc::Thread::Current();
+  RTC_DCHECK(ui_thread_);
+  created_ = true;
+  SwitchToConnectUI();
+  return true;
+}
+
+bool NullMainWnd::Destroy() {
+  if (!created_)
+    return false;
+  created_ = false;
+  return true;
+}
+
+void NullMainWnd::SwitchToConnectUI() {
+  RTC_LOG(LS_INFO) << __FUNCTION__;
+  ui_ = CONNECT_TO_SERVER;
+  // Nobody is there to connect (again), so the run is over once the client
+  // is signed out.
+  if (!autoconnect_ || login_started_) {
+    RTC_LOG(LS_INFO) << "Nothing left to do; closing";
+    Destroy();
+    return;
+  }
+  // Like the GTK window's simulated click, this runs once the message loop
+  // does, after the conductor has registered.
+  ui_thread_->PostTask(SafeTask(safety_.flag(), [this] {
+    if (callback_ && created_ && ui_ == CONNECT_TO_SERVER) {
+      login_started_ = true;
+      callback_->StartLogin(server_, port_);
+    }
+  }));
+}
+
+void NullMainWnd::SwitchToPeerList(const Peers& peers) {
+  RTC_LOG(LS_INFO) << __FUNCTION__ << ": " << peers.size() << " peers";
+  ui_ = LIST_PEERS;
+  // The GTK window calls the last row of its list, the highest peer id.
+  if (autocall_ && !peers.empty()) {
+    int peer_id = peers.rbegin()->first;
+    ui_thread_->PostTask(SafeTask(safety_.flag(), [this, peer_id] {
+      if (callback_)
+        callback_->ConnectToPeer(peer_id);
+    }));
+  }
+}
+
+void NullMainWnd::SwitchToStreamingUI() {
+  RTC_LOG(LS_INFO) << __FUNCTION__;
+  ui_ = STREAMING;
+}
+
+void NullMainWnd::MessageBox(const char* caption,
+                             const char* text,
+                             bool is_error) {
+  if (is_error) {
+    RTC_LOG(LS_ERROR) << caption << ": " << text;
+  } else {
+    RTC_LOG(LS_INFO) << caption << ": " << text;
+  }
+  // An error before signing in, such as the server giving up on us, can't
+  // be retried by anyone.
+  if (is_error && ui_ == CONNECT_TO_SERVER)
+    Destroy();
+}
+
+void NullMainWnd::QueueUIThreadCallback(int msg_id, void* data) {
+  // Also called from the signaling thread; PostTask is thread safe, and the
+  // task is dropped if this window is gone by the time it runs.
+  ui_thread_->PostTask(SafeTask(safety_.flag(), [this, msg_id, data] {
+    if (callback_)
+      callback_->UIThreadCallback(msg_id, data);
+  }));
+}
@@ -0,0 +1,73 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_NULL_MAIN_WND_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_NULL_MAIN_WND_H_
+
+#include <string>
+
+#include "api/media_stream_interface.h"
+#include "api/task_queue/pending_task_safety_flag.h"
+#include "examples/headless_peerconnection/client/headless_peer_connection_client.h"
+#include "examples/headless_peerconnection/client/main_wnd.h"
+#include "rtc_base/thread.h"
+
+// A main window that isn't there, for running without a display or GUI
+// libraries.  It only tracks which UI would be showing, does what
+// --autoconnect and --autocall would have the GTK window click, logs
+// message boxes, and renders no video, so received frames are decoded but
+// never converted.  UI thread callbacks run as tasks on the thread that
+// called Create().  With nobody to click Connect, the window closes itself,
+// ending the message loop, when it's back at the connect UI after signing
+// out, or when an error is shown before signing in.
+class NullMainWnd : public MainWindow {
+ public:
+  NullMainWnd(const char* server, int port, bool autoconnect, bool autocall);
+  ~NullMainWnd() override;
+
+  void RegisterObserver(MainWndCallback* callback) override;
+  bool IsWindow() override;
+  void SwitchToConnectUI() override;
+  void SwitchToPeerList(const Peers& peers) override;
+  void SwitchToStreamingUI() override;
+  void MessageBox(const char* caption, const char* text,
+                  bool is_error) override;
+  MainWindow::UI current_ui() override { return ui_; }
+  void StartLocalRenderer(webrtc::VideoTrackInterface* local_video) override {}
+  void StopLocalRenderer() override {}
+  void StartRemoteRenderer(
+      webrtc::VideoTrackInterface* remote_video) override {}
+  void StopRemoteRenderer() override {}
+
+  void QueueUIThreadCallback(int msg_id, void* data) override;
+
+  // Starts at the connect UI on the current thread, which must run the
+  // message loop.
+  bool Create();
+
+  // After this IsWindow() is false, so the message loop ends once the
+  // client is disconnected.
+  bool Destroy();
+
+ private:
+  rtc::Thread* ui_thread_;
+  MainWndCallback* callback_;
+  UI ui_;
+  bool created_;
+  // StartLogin() was called; going back to the connect UI ends the run.
+  bool login_started_;
+  std::string server_;
+  int port_;
+  bool autoconnect_;
+  bool autocall_;
+  webrtc::ScopedTaskSafety safety_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_NULL_MAIN_WND_H_
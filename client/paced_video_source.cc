@@ -0,0 +1,69 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/paced_video_source.h"
+
+#include "api/units/time_delta.h"
+#include "api/video/video_rotation.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/time_utils.h"
+
+PacedVideoTrackSource::PacedVideoTrackSource(int fps_numerator,
+                                             int fps_denominator)
+    : VideoTrackSource(/*remote=*/false),
+      fps_numerator_(fps_numerator),
+      fps_denominator_(fps_denominator),
+      started_us_(0),
+      frames_delivered_(0) {
+  RTC_DCHECK_GT(fps_numerator_, 0);
+  RTC_DCHECK_GT(fps_denominator_, 0);
+}
+
+PacedVideoTrackSource::~PacedVideoTrackSource() {
+  RTC_DCHECK(!pacer_thread_);
+}
+
+void PacedVideoTrackSource::Start(const char* thread_name) {
+  RTC_DCHECK(!pacer_thread_);
+  pacer_thread_ = rtc::Thread::Create();
+  pacer_thread_->SetName(thread_name, nullptr);
+  pacer_thread_->Start();
+  pacer_thread_->PostTask([this] {
+    started_us_ = rtc::TimeMicros();
+    DeliverFrame();
+  });
+}
+
+void PacedVideoTrackSource::Stop() {
+  // The frame scheduled next is dropped along with the thread.
+  if (pacer_thread_)
+    pacer_thread_->Stop();
+  pacer_thread_ = nullptr;
+}
+
+void PacedVideoTrackSource::DeliverFrame() {
+  rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer =
+      NextFrame(frames_delivered_);
+  if (buffer) {
+    broadcaster_.OnFrame(webrtc::VideoFrame::Builder()
+                             .set_video_frame_buffer(buffer)
+                             .set_timestamp_us(rtc::TimeMicros())
+                             .set_rotation(webrtc::kVideoRotation_0)
+                             .build());
+  }
+
+  ++frames_delivered_;
+  int64_t next_us = started_us_ + frames_delivered_ * rtc::kNumMicrosecsPerSec *
+                                      fps_denominator_ / fps_numerator_;
+  int64_t delay_us = next_us - rtc::TimeMicros();
+  pacer_thread_->PostDelayedHighPrecisionTask(
+      [this] { DeliverFrame(); },
+      webrtc::TimeDelta::Micros(delay_us > 0 ? delay_us : 0));
+}
@@ -0,0 +1,61 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_PACED_VIDEO_SOURCE_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_PACED_VIDEO_SOURCE_H_
+
+#include <stdint.h>
+
+#include <memory>
+
+#include "api/scoped_refptr.h"
+#include "api/video/video_frame.h"
+#include "api/video/video_frame_buffer.h"
+#include "media/base/video_broadcaster.h"
+#include "pc/video_track_source.h"
+#include "rtc_base/thread.h"
+
+// A local video source that makes its own frames, at a fixed rate, on a
+// thread of its own.  Each deadline is counted from when the source
+// started, so that timer slack doesn't add up over a long run.
+class PacedVideoTrackSource : public webrtc::VideoTrackSource {
+ protected:
+  PacedVideoTrackSource(int fps_numerator, int fps_denominator);
+  ~PacedVideoTrackSource() override;
+
+  // Starts the thread named `thread_name`, which calls NextFrame() from
+  // then on.
+  void Start(const char* thread_name);
+  // Must be called by the destructor of a subclass, so that NextFrame()
+  // isn't called on a half-destroyed object.
+  void Stop();
+
+  // Returns frame `index` of the stream, counting from 0, or null to skip
+  // it.  Called on the pacer thread.
+  virtual rtc::scoped_refptr<webrtc::VideoFrameBuffer> NextFrame(
+      int64_t index) = 0;
+
+ private:
+  rtc::VideoSourceInterface<webrtc::VideoFrame>* source() override {
+    return &broadcaster_;
+  }
+
+  // Sends the next frame and schedules the one after it.
+  void DeliverFrame();
+
+  const int fps_numerator_;
+  const int fps_denominator_;
+  rtc::VideoBroadcaster broadcaster_;
+  std::unique_ptr<rtc::Thread> pacer_thread_;
+  int64_t started_us_;
+  int64_t frames_delivered_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_PACED_VIDEO_SOURCE_H_
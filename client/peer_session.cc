@@ -0,0 +1,367 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/peer_session.h"
+
+#include <stddef.h>
+
+#include <utility>
+
+#include "absl/types/optional.h"
+#include "api/rtp_sender_interface.h"
+#include "examples/headless_peerconnection/client/defaults.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/logging.h"
+
+namespace {
+
+// Messages that pile up while a POST is in flight are sent together as a JSON
+// array, up to this many bytes of messages per POST.
+const size_t kMaxSignalingBatchSize = 64 * 1024;
+
+class DummySetSessionDescriptionObserver
+    : public webrtc::SetSessionDescriptionObserver {
+ public:
+  // `event` is marked for the call with `peer_id` on `timeline` once the
+  // description is set, if given.
+  static rtc::scoped_refptr<DummySetSessionDescriptionObserver> Create(
+      SignalingTimeline* timeline = nullptr,
+      int peer_id = -1,
+      const char* event = nullptr) {
+    return rtc::make_ref_counted<DummySetSessionDescriptionObserver>(
+        timeline, peer_id, event);
+  }
+  DummySetSessionDescriptionObserver(SignalingTimeline* timeline,
+                                     int peer_id,
+                                     const char* event)
+      : timeline_(timeline), peer_id_(peer_id), event_(event) {}
+  virtual void OnSuccess() {
+    RTC_LOG(LS_INFO) << __FUNCTION__;
+    if (timeline_)
+      timeline_->Mark(peer_id_, SignalingTimeline::kSignaling, event_);
+  }
+  virtual void OnFailure(webrtc::RTCError error) {
+    RTC_LOG(LS_INFO) << __FUNCTION__ << " " << ToString(error.type()) << ": "
+                     << error.message();
+  }
+
+ private:
+  SignalingTimeline* const timeline_;
+  const int peer_id_;
+  const char* const event_;
+};
+
+}  // namespace
+
+PeerSession::PeerSession(int peer_id,
+                         PeerSessionObserver* observer,
+                         SignalingTimeline* timeline)
+    : peer_id_(peer_id),
+      observer_(observer),
+      timeline_(timeline),
+      loopback_(false),
+      ice_candidate_pool_size_(0) {}
+
+PeerSession::~PeerSession() {
+  RTC_DCHECK(!peer_connection_);
+}
+
+bool PeerSession::Initialize(
+    rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory,
+    const std::vector<rtc::scoped_refptr<webrtc::MediaStreamTrackInterface>>&
+        tracks,
+    int ice_candidate_pool_size,
+    rtc::scoped_refptr<rtc::RTCCertificate> certificate) {
+  RTC_DCHECK(!peer_connection_);
+  factory_ = std::move(factory);
+  ice_candidate_pool_size_ = ice_candidate_pool_size;
+  certificate_ = std::move(certificate);
+  if (!CreatePeerConnection())
+    return false;
+
+  for (const auto& track : tracks) {
+    auto result_or_error = peer_connection_->AddTrack(track, {kStreamId});
+    if (!result_or_error.ok()) {
+      RTC_LOG(LS_ERROR) << "Failed to add " << track->kind()
+                        << " track to PeerConnection: "
+                        << result_or_error.error().message();
+    }
+  }
+  return true;
+}
+
+void PeerSession::AssignPeer(int peer_id) {
+  RTC_DCHECK_EQ(peer_id_, -1);
+  peer_id_ = peer_id;
+}
+
+void PeerSession::CreateOffer() {
+  Mark(SignalingTimeline::kSignaling, "create_offer");
+  peer_connection_->CreateOffer(
+      this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+}
+
+bool PeerSession::CreatePeerConnection() {
+  RTC_DCHECK(factory_);
+  RTC_DCHECK(!peer_connection_);
+
+  webrtc::PeerConnectionInterface::RTCConfiguration config;
+  config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
+  webrtc::PeerConnectionInterface::IceServer server;
+  server.uri = GetPeerConnectionString();
+  config.servers.push_back(server);
+  config.ice_candidate_pool_size = ice_candidate_pool_size_;
+  if (certificate_)
+    config.certificates.push_back(certificate_);
+
+  webrtc::PeerConnectionDependencies pc_dependencies(this);
+  auto error_or_peer_connection = factory_->CreatePeerConnectionOrError(
+      config, std::move(pc_dependencies));
+  if (error_or_peer_connection.ok()) {
+    peer_connection_ = std::move(error_or_peer_connection.value());
+  }
+  return peer_connection_ != nullptr;
+}
+
+bool PeerSession::ReinitializePeerConnectionForLoopback() {
+  loopback_ = true;
+  std::vector<rtc::scoped_refptr<webrtc::RtpSenderInterface>> senders =
+      peer_connection_->GetSenders();
+  peer_connection_ = nullptr;
+  // Loopback is only possible if encryption is disabled.  The factory is
+  // shared, so it's only disabled while this PeerConnection is created.
+  webrtc::PeerConnectionFactoryInterface::Options options;
+  options.disable_encryption = true;
+  factory_->SetOptions(options);
+  if (CreatePeerConnection()) {
+    for (const auto& sender : senders) {
+      peer_connection_->AddTrack(sender->track(), sender->stream_ids());
+    }
+    peer_connection_->CreateOffer(
+        this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+  }
+  options.disable_encryption = false;
+  factory_->SetOptions(options);
+  return peer_connection_ != nullptr;
+}
+
+bool PeerSession::OnSignalingMessage(const SignalingMessage& message) {
+  if (message.kind == SignalingMessage::kSessionDescription) {
+    const std::string& type_str = message.type;
+    if (type_str == "offer-loopback") {
+      // This is a loopback call.
+      // Recreate the peerconnection with DTLS disabled.
+      if (!ReinitializePeerConnectionForLoopback()) {
+        RTC_LOG(LS_ERROR) << "Failed to initialize our PeerConnection instance";
+        return false;
+      }
+      return true;
+    }
+    absl::optional<webrtc::SdpType> type_maybe =
+        webrtc::SdpTypeFromString(type_str);
+    if (!type_maybe) {
+      RTC_LOG(LS_ERROR) << "Unknown SDP type: " << type_str;
+      return true;
+    }
+    webrtc::SdpType type = *type_maybe;
+    webrtc::SdpParseError error;
+    std::unique_ptr<webrtc::SessionDescriptionInterface> session_description =
+        webrtc::CreateSessionDescription(type, message.sdp, &error);
+    if (!session_description) {
+      RTC_LOG(LS_WARNING)
+          << "Can't parse received session description message. "
+             "SdpParseError was: "
+          << error.description;
+      return true;
+    }
+    RTC_LOG(LS_INFO) << " Received session description :" << message.sdp;
+    Mark(SignalingTimeline::kSignaling, "remote_description_received",
+         type_str);
+    peer_connection_->SetRemoteDescription(
+        DummySetSessionDescriptionObserver::Create(timeline_, peer_id_,
+                                                   "remote_description_set")
+            .get(),
+        session_description.release());
+    if (type == webrtc::SdpType::kOffer) {
+      Mark(SignalingTimeline::kSignaling, "create_answer");
+      peer_connection_->CreateAnswer(
+          this, webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+    }
+  } else if (message.kind == SignalingMessage::kCandidate) {
+    webrtc::SdpParseError error;
+    std::unique_ptr<webrtc::IceCandidateInterface> candidate(
+        webrtc::CreateIceCandidate(message.sdp_mid, message.sdp_mline_index,
+                                   message.candidate, &error));
+    if (!candidate.get()) {
+      RTC_LOG(LS_WARNING) << "Can't parse received candidate message. "
+                             "SdpParseError was: "
+                          << error.description;
+      return true;
+    }
+    Mark(SignalingTimeline::kIce, "candidate_received", message.sdp_mid);
+    if (!peer_connection_->AddIceCandidate(candidate.get())) {
+      RTC_LOG(LS_WARNING) << "Failed to apply the received candidate";
+      return true;
+    }
+    RTC_LOG(LS_INFO) << " Received candidate :" << message.candidate;
+  } else {
+    RTC_LOG(LS_WARNING) << "Can't parse received message.";
+  }
+  return true;
+}
+
+void PeerSession::Close(int my_id, const std::string& trace_path) {
+  // Closed explicitly, since the stats threads may hold on to it for a
+  // moment.  No observer methods are called once it's closed.
+  if (peer_connection_)
+    peer_connection_->Close();
+  peer_connection_ = nullptr;
+  factory_ = nullptr;
+  certificate_ = nullptr;
+  if (remote_video_track_) {
+    remote_video_track_->RemoveSink(first_frame_marker_.get());
+    remote_video_track_ = nullptr;
+  }
+  first_frame_marker_.reset();
+  timeline_->EndCall(my_id, peer_id_, trace_path);
+  pending_messages_.clear();
+  loopback_ = false;
+}
+
+void PeerSession::QueueMessage(std::string message) {
+  pending_messages_.push_back(std::move(message));
+}
+
+std::string PeerSession::TakeSignalingBatch() {
+  RTC_DCHECK(!pending_messages_.empty());
+  std::string batch = std::move(pending_messages_.front());
+  pending_messages_.pop_front();
+  if (pending_messages_.empty())
+    return batch;  // Sent as is, so peers that don't batch understand it.
+
+  batch.insert(0, 1, '[');
+  while (!pending_messages_.empty() &&
+         batch.length() + pending_messages_.front().length() <
+             kMaxSignalingBatchSize) {
+    batch += ',';
+    batch += pending_messages_.front();
+    pending_messages_.pop_front();
+  }
+  batch += ']';
+  return batch;
+}
+
+void PeerSession::Mark(SignalingTimeline::Category category,
+                       const char* name,
+                       const std::string& detail) {
+  timeline_->Mark(peer_id_, category, name, detail);
+}
+
+//
+// PeerConnectionObserver implementation.
+//
+
+void PeerSession::OnAddTrack(
+    rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
+    const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>&
+        streams) {
+  RTC_LOG(LS_INFO) << __FUNCTION__ << " " << receiver->id();
+  rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track =
+      receiver->track();
+  if (track->kind() == webrtc::MediaStreamTrackInterface::kVideoKind &&
+      !remote_video_track_) {
+    remote_video_track_ = rtc::scoped_refptr<webrtc::VideoTrackInterface>(
+        static_cast<webrtc::VideoTrackInterface*>(track.get()));
+    first_frame_marker_ = std::make_unique<FirstFrameMarker>(timeline_,
+                                                             peer_id_);
+    remote_video_track_->AddOrUpdateSink(first_frame_marker_.get(),
+                                         rtc::VideoSinkWants());
+  }
+  observer_->OnSessionTrackAdded(peer_id_, std::move(track));
+}
+
+void PeerSession::OnRemoveTrack(
+    rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) {
+  RTC_LOG(LS_INFO) << __FUNCTION__ << " " << receiver->id();
+  observer_->OnSessionTrackRemoved(peer_id_, receiver->track());
+}
+
+void PeerSession::OnIceConnectionChange(
+    webrtc::PeerConnectionInterface::IceConnectionState new_state) {
+  std::string state(webrtc::PeerConnectionInterface::AsString(new_state));
+  RTC_LOG(LS_INFO) << __FUNCTION__ << " " << peer_id_ << " " << state;
+  Mark(SignalingTimeline::kIce, "ice_connection_state", state);
+  if (new_state ==
+      webrtc::PeerConnectionInterface::kIceConnectionConnected) {
+    Mark(SignalingTimeline::kIce, "ice_connected");
+  }
+}
+
+void PeerSession::OnIceCandidate(
+    const webrtc::IceCandidateInterface* candidate) {
+  RTC_LOG(LS_INFO) << __FUNCTION__ << " " << candidate->sdp_mline_index();
+  // For loopback test. To save some connecting delay.
+  if (loopback_) {
+    if (!peer_connection_->AddIceCandidate(candidate)) {
+      RTC_LOG(LS_WARNING) << "Failed to apply the received candidate";
+    }
+    return;
+  }
+
+  std::string sdp;
+  if (!candidate->ToString(&sdp)) {
+    RTC_LOG(LS_ERROR) << "Failed to serialize candidate";
+    return;
+  }
+  std::string message;
+  EncodeCandidate(candidate->sdp_mid(), candidate->sdp_mline_index(), sdp,
+                  &message);
+  Mark(SignalingTimeline::kIce, "candidate_sent", candidate->sdp_mid());
+  Mark(SignalingTimeline::kSignaling, "message_queued", "candidate");
+
+  observer_->OnSessionMessage(peer_id_, std::move(message));
+}
+
+//
+// CreateSessionDescriptionObserver implementation.
+//
+
+void PeerSession::OnSuccess(webrtc::SessionDescriptionInterface* desc) {
+  Mark(SignalingTimeline::kSignaling, "create_sdp_success",
+       webrtc::SdpTypeToString(desc->GetType()));
+  peer_connection_->SetLocalDescription(
+      DummySetSessionDescriptionObserver::Create().get(), desc);
+
+  std::string sdp;
+  desc->ToString(&sdp);
+
+  // For loopback test. To save some connecting delay.
+  if (loopback_) {
+    // Replace message type from "offer" to "answer"
+    std::unique_ptr<webrtc::SessionDescriptionInterface> session_description =
+        webrtc::CreateSessionDescription(webrtc::SdpType::kAnswer, sdp);
+    peer_connection_->SetRemoteDescription(
+        DummySetSessionDescriptionObserver::Create().get(),
+        session_description.release());
+    return;
+  }
+
+  std::string message;
+  EncodeSessionDescription(webrtc::SdpTypeToString(desc->GetType()), sdp,
+                           &message);
+
+  Mark(SignalingTimeline::kSignaling, "message_queued",
+       webrtc::SdpTypeToString(desc->GetType()));
+  observer_->OnSessionMessage(peer_id_, std::move(message));
+}
+
+void PeerSession::OnFailure(webrtc::RTCError error) {
+  RTC_LOG(LS_ERROR) << ToString(error.type()) << ": " << error.message();
+}
@@ -0,0 +1,144 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_PEER_SESSION_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_PEER_SESSION_H_
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api/media_stream_interface.h"
+#include "api/peer_connection_interface.h"
+#include "api/scoped_refptr.h"
+#include "examples/headless_peerconnection/client/signaling_codec.h"
+#include "examples/headless_peerconnection/client/signaling_timeline.h"
+#include "rtc_base/rtc_certificate.h"
+
+// Gets what a session has for the main thread.  Called on the signaling
+// thread.
+struct PeerSessionObserver {
+  // `message` is a JSON object to send to the session's peer.
+  virtual void OnSessionMessage(int peer_id, std::string message) = 0;
+  virtual void OnSessionTrackAdded(
+      int peer_id,
+      rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track) = 0;
+  virtual void OnSessionTrackRemoved(
+      int peer_id,
+      rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track) = 0;
+
+ protected:
+  virtual ~PeerSessionObserver() {}
+};
+
+// A call with one remote peer: its PeerConnection and the signaling
+// messages waiting to go out to the peer.  The sessions of a client share
+// one PeerConnectionFactory and the local tracks.
+//
+// The PeerConnection calls the observer methods on the signaling thread;
+// everything else runs on the main thread.
+class PeerSession : public webrtc::PeerConnectionObserver,
+                    public webrtc::CreateSessionDescriptionObserver {
+ public:
+  PeerSession(int peer_id,
+              PeerSessionObserver* observer,
+              SignalingTimeline* timeline);
+
+  // -1 for a standby session that isn't assigned to a call yet.
+  int peer_id() const { return peer_id_; }
+  // Hands a standby session to the call with `peer_id`.  Must be done
+  // before anything is negotiated, so that the observer methods, which read
+  // the peer id on the signaling thread, only run after it.
+  void AssignPeer(int peer_id);
+  rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection()
+      const {
+    return peer_connection_;
+  }
+
+  // Creates the PeerConnection with `factory` and adds `tracks` to it.  A
+  // nonzero `ice_candidate_pool_size` has it start gathering that many sets
+  // of ICE candidates right away, before there's an offer or answer.  The
+  // PeerConnection generates its own DTLS certificate unless given one.
+  bool Initialize(
+      rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory,
+      const std::vector<rtc::scoped_refptr<webrtc::MediaStreamTrackInterface>>&
+          tracks,
+      int ice_candidate_pool_size = 0,
+      rtc::scoped_refptr<rtc::RTCCertificate> certificate = nullptr);
+  void CreateOffer();
+
+  // Handles a single session description or ICE candidate from the peer.
+  // Returns false if the session can't go on.
+  bool OnSignalingMessage(const SignalingMessage& message);
+
+  // Closes the PeerConnection and writes the call's signaling trace to
+  // `trace_path`, if not empty.
+  void Close(int my_id, const std::string& trace_path);
+
+  // Messages to the peer go through a queue, so that they're sent to the
+  // server in the order they were signaled.
+  void QueueMessage(std::string message);
+  bool has_pending_messages() const { return !pending_messages_.empty(); }
+  // Removes the next message, batched together with the ones behind it into
+  // a JSON array if there are any.
+  std::string TakeSignalingBatch();
+
+  //
+  // PeerConnectionObserver implementation.
+  //
+
+  void OnSignalingChange(
+      webrtc::PeerConnectionInterface::SignalingState new_state) override {}
+  void OnAddTrack(
+      rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
+      const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>&
+          streams) override;
+  void OnRemoveTrack(
+      rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) override;
+  void OnDataChannel(
+      rtc::scoped_refptr<webrtc::DataChannelInterface> channel) override {}
+  void OnRenegotiationNeeded() override {}
+  void OnIceConnectionChange(
+      webrtc::PeerConnectionInterface::IceConnectionState new_state) override;
+  void OnIceGatheringChange(
+      webrtc::PeerConnectionInterface::IceGatheringState new_state) override {}
+  void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override;
+  void OnIceConnectionReceivingChange(bool receiving) override {}
+
+  // CreateSessionDescriptionObserver implementation.
+  void OnSuccess(webrtc::SessionDescriptionInterface* desc) override;
+  void OnFailure(webrtc::RTCError error) override;
+
+ protected:
+  ~PeerSession() override;
+
+ private:
+  bool CreatePeerConnection();
+  bool ReinitializePeerConnectionForLoopback();
+  void Mark(SignalingTimeline::Category category,
+            const char* name,
+            const std::string& detail = "");
+
+  int peer_id_;
+  PeerSessionObserver* const observer_;
+  SignalingTimeline* const timeline_;
+  bool loopback_;
+  int ice_candidate_pool_size_;
+  rtc::scoped_refptr<rtc::RTCCertificate> certificate_;
+  rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory_;
+  rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
+  std::deque<std::string> pending_messages_;
+  // The remote video track `first_frame_marker_` watches.
+  rtc::scoped_refptr<webrtc::VideoTrackInterface> remote_video_track_;
+  std::unique_ptr<FirstFrameMarker> first_frame_marker_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_PEER_SESSION_H_
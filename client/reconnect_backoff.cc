@@ -0,0 +1,43 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/reconnect_backoff.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+
+ReconnectBackoff::ReconnectBackoff() : attempts_(0) {
+  // Clients started together must not share the seed.
+  std::random_device seed;
+  random_.seed((static_cast<uint64_t>(seed()) << 32) | seed());
+}
+
+bool ReconnectBackoff::NextDelay(webrtc::TimeDelta* delay) {
+  if (policy_.max_attempts > 0 && attempts_ >= policy_.max_attempts)
+    return false;
+
+  int retry = attempts_++;
+  if (retry == 0) {
+    *delay = webrtc::TimeDelta::Zero();
+    return true;
+  }
+
+  // Doubling stops at the cap, well before the shift could overflow.
+  int64_t max_us = std::max<int64_t>(policy_.max_delay.us(), 0);
+  int64_t ceiling_us = std::max<int64_t>(policy_.initial_delay.us(), 0);
+  for (int i = 1; i < retry && ceiling_us < max_us; ++i)
+    ceiling_us *= 2;
+  ceiling_us = std::min(ceiling_us, max_us);
+
+  std::uniform_int_distribution<int64_t> jitter(0, ceiling_us);
+  *delay = webrtc::TimeDelta::Micros(jitter(random_));
+  return true;
+}
@@ -0,0 +1,53 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_RECONNECT_BACKOFF_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_RECONNECT_BACKOFF_H_
+
+#include <random>
+
+#include "api/units/time_delta.h"
+
+// How PeerConnectionClient retries a connection to the server that failed.
+// The first retry is made right away.  Every one after that waits a random
+// time of up to `initial_delay`, doubled for each earlier attempt and capped
+// at `max_delay`.
+struct ReconnectPolicy {
+  webrtc::TimeDelta initial_delay = webrtc::TimeDelta::Millis(500);
+  webrtc::TimeDelta max_delay = webrtc::TimeDelta::Seconds(30);
+  // Retries made before giving up, or 0 to never give up.  A client that
+  // gives up stays signed out until it is told to connect again.
+  int max_attempts = 0;
+};
+
+// Hands out the delays of consecutive retries under a ReconnectPolicy.  The
+// delays are drawn from the whole range ("full jitter"), so that clients
+// that lost the server at the same moment don't all come back at once.
+class ReconnectBackoff {
+ public:
+  ReconnectBackoff();
+
+  void set_policy(const ReconnectPolicy& policy) { policy_ = policy; }
+
+  // Returns false once the retry budget is used up.
+  bool NextDelay(webrtc::TimeDelta* delay);
+
+  // Starts over, after a connection worked out.
+  void Reset() { attempts_ = 0; }
+
+  int attempts() const { return attempts_; }
+
+ private:
+  ReconnectPolicy policy_;
+  int attempts_;
+  std::mt19937_64 random_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_RECONNECT_BACKOFF_H_
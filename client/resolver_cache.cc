@@ -0,0 +1,46 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/resolver_cache.h"
+
+#include "rtc_base/time_utils.h"
+
+ResolverCache::ResolverCache(webrtc::TimeDelta ttl) : ttl_(ttl) {}
+
+ResolverCache::~ResolverCache() = default;
+
+bool ResolverCache::Lookup(const std::string& host, Entry* entry) const {
+  auto it = entries_.find(host);
+  if (it == entries_.end() || it->second.expires_ms <= rtc::TimeMillis())
+    return false;
+  *entry = it->second.entry;
+  return true;
+}
+
+const ResolverCache::Entry& ResolverCache::Store(const std::string& host,
+                                                const Entry& entry) {
+  CachedEntry& cached = entries_[host];
+  int preferred_family = cached.expires_ms ? cached.entry.preferred_family
+                                           : entry.preferred_family;
+  cached.entry = entry;
+  cached.entry.preferred_family = preferred_family;
+  cached.expires_ms = rtc::TimeMillis() + ttl_.ms();
+  return cached.entry;
+}
+
+void ResolverCache::SetPreferredFamily(const std::string& host, int family) {
+  auto it = entries_.find(host);
+  if (it != entries_.end())
+    it->second.entry.preferred_family = family;
+}
+
+void ResolverCache::Forget(const std::string& host) {
+  entries_.erase(host);
+}
@@ -0,0 +1,61 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_RESOLVER_CACHE_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_RESOLVER_CACHE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "api/units/time_delta.h"
+#include "rtc_base/ip_address.h"
+
+// Remembers what a server host name resolved to, so that signing in again
+// skips the DNS lookup while the answer is fresh.  The resolver doesn't
+// report record TTLs, so every entry is kept for the same time.
+class ResolverCache {
+ public:
+  struct Entry {
+    // Either may be nil, but not both.
+    rtc::IPAddress ipv4;
+    rtc::IPAddress ipv6;
+    // The address family the last successful connection used.
+    int preferred_family = AF_INET;
+  };
+
+  explicit ResolverCache(webrtc::TimeDelta ttl);
+  ~ResolverCache();
+
+  // Returns false if `host` isn't cached or its entry expired.
+  bool Lookup(const std::string& host, Entry* entry) const;
+  // Returns the entry as stored.  It keeps the family preference learned
+  // for an earlier, expired entry.
+  const Entry& Store(const std::string& host, const Entry& entry);
+
+  // Lets the next connection start with the family that worked.
+  void SetPreferredFamily(const std::string& host, int family);
+
+  // Drops `host`, so that it's looked up again after none of its addresses
+  // could be reached.
+  void Forget(const std::string& host);
+
+ private:
+  struct CachedEntry {
+    Entry entry;
+    int64_t expires_ms = 0;
+  };
+
+  const webrtc::TimeDelta ttl_;
+  std::map<std::string, CachedEntry> entries_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_RESOLVER_CACHE_H_
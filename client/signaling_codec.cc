@@ -0,0 +1,431 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/signaling_codec.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <limits>
+
+namespace {
+
+// Names used for a IceCandidate JSON object.
+const char kCandidateSdpMidName[] = "sdpMid";
+const char kCandidateSdpMlineIndexName[] = "sdpMLineIndex";
+const char kCandidateSdpName[] = "candidate";
+
+// Names used for a SessionDescription JSON object.
+const char kSessionDescriptionTypeName[] = "type";
+const char kSessionDescriptionSdpName[] = "sdp";
+
+// Nesting allowed in members that are skipped.
+const int kMaxDepth = 32;
+
+bool NeedsEscape(char c) {
+  return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+// Upper bound of the escaped length, to reserve for.  SDP escapes two
+// characters per line, so a sixth on top is plenty in practice.
+size_t EscapedSizeHint(absl::string_view value) {
+  return value.size() + value.size() / 6 + 2;
+}
+
+void AppendString(absl::string_view value, std::string* out) {
+  out->push_back('"');
+  size_t run = 0;
+  for (size_t i = 0; i < value.size(); ++i) {
+    char c = value[i];
+    if (!NeedsEscape(c))
+      continue;
+    out->append(value.data() + run, i - run);
+    run = i + 1;
+    switch (c) {
+      case '"':
+        out->append("\\\"");
+        break;
+      case '\\':
+        out->append("\\\\");
+        break;
+      case '\n':
+        out->append("\\n");
+        break;
+      case '\r':
+        out->append("\\r");
+        break;
+      case '\t':
+        out->append("\\t");
+        break;
+      default: {
+        char escaped[7];
+        snprintf(escaped, sizeof(escaped), "\\u%04x",
+                 static_cast<unsigned char>(c));
+        out->append(escaped, 6);
+        break;
+      }
+    }
+  }
+  out->append(value.data() + run, value.size() - run);
+  out->push_back('"');
+}
+
+void AppendName(absl::string_view name, std::string* out) {
+  // The names need no escaping.
+  out->push_back('"');
+  out->append(name.data(), name.size());
+  out->append("\":");
+}
+
+void AppendUtf8(uint32_t code_point, std::string* out) {
+  if (code_point < 0x80) {
+    out->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out->push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else if (code_point < 0x10000) {
+    out->push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else {
+    out->push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  }
+}
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+}  // namespace
+
+void EncodeSessionDescription(absl::string_view type,
+                              absl::string_view sdp,
+                              std::string* out) {
+  out->reserve(out->size() + EscapedSizeHint(type) + EscapedSizeHint(sdp) +
+               sizeof(kSessionDescriptionTypeName) +
+               sizeof(kSessionDescriptionSdpName) + 8);
+  out->push_back('{');
+  AppendName(kSessionDescriptionTypeName, out);
+  AppendString(type, out);
+  out->push_back(',');
+  AppendName(kSessionDescriptionSdpName, out);
+  AppendString(sdp, out);
+  out->push_back('}');
+}
+
+void EncodeCandidate(absl::string_view sdp_mid,
+                     int sdp_mline_index,
+                     absl::string_view candidate,
+                     std::string* out) {
+  char index[16];
+  int index_length = snprintf(index, sizeof(index), "%d", sdp_mline_index);
+  out->reserve(out->size() + EscapedSizeHint(sdp_mid) +
+               EscapedSizeHint(candidate) + index_length +
+               sizeof(kCandidateSdpMidName) +
+               sizeof(kCandidateSdpMlineIndexName) +
+               sizeof(kCandidateSdpName) + 12);
+  out->push_back('{');
+  AppendName(kCandidateSdpMidName, out);
+  AppendString(sdp_mid, out);
+  out->push_back(',');
+  AppendName(kCandidateSdpMlineIndexName, out);
+  out->append(index, index_length);
+  out->push_back(',');
+  AppendName(kCandidateSdpName, out);
+  AppendString(candidate, out);
+  out->push_back('}');
+}
+
+SignalingMessageReader::SignalingMessageReader(absl::string_view json)
+    : json_(json),
+      pos_(0),
+      in_array_(false),
+      first_(true),
+      done_(false),
+      failed_(false) {
+  SkipWhitespace();
+  if (Consume('['))
+    in_array_ = true;
+}
+
+bool SignalingMessageReader::Next(SignalingMessage* message) {
+  if (done_ || failed_)
+    return false;
+
+  SkipWhitespace();
+  if (in_array_) {
+    if (Consume(']')) {
+      done_ = true;
+    } else if (!first_ && !Consume(',')) {
+      return Fail();
+    }
+    SkipWhitespace();
+  } else if (!first_) {
+    done_ = true;
+  }
+  first_ = false;
+
+  if (done_) {
+    // Nothing may follow the message or batch.
+    SkipWhitespace();
+    if (pos_ != json_.size())
+      Fail();
+    return false;
+  }
+  return ParseObject(message);
+}
+
+bool SignalingMessageReader::ParseObject(SignalingMessage* message) {
+  message->kind = SignalingMessage::kUnknown;
+  message->type.clear();
+  message->sdp.clear();
+  message->sdp_mid.clear();
+  message->sdp_mline_index = 0;
+  message->candidate.clear();
+  bool has_type = false;
+  bool has_sdp_mid = false;
+  bool has_sdp_mline_index = false;
+  bool has_candidate = false;
+
+  if (!Consume('{'))
+    return Fail();
+  SkipWhitespace();
+  if (!Consume('}')) {
+    do {
+      SkipWhitespace();
+      if (!ParseString(&key_))
+        return Fail();
+      SkipWhitespace();
+      if (!Consume(':'))
+        return Fail();
+      SkipWhitespace();
+
+      // A member of another type than expected is skipped like an unknown
+      // one.
+      bool is_string = pos_ < json_.size() && json_[pos_] == '"';
+      bool parsed = false;
+      if (is_string && key_ == kSessionDescriptionTypeName) {
+        parsed = has_type = ParseString(&message->type);
+      } else if (is_string && key_ == kSessionDescriptionSdpName) {
+        parsed = ParseString(&message->sdp);
+      } else if (is_string && key_ == kCandidateSdpMidName) {
+        parsed = has_sdp_mid = ParseString(&message->sdp_mid);
+      } else if (is_string && key_ == kCandidateSdpName) {
+        parsed = has_candidate = ParseString(&message->candidate);
+      } else if (!is_string && key_ == kCandidateSdpMlineIndexName) {
+        parsed = has_sdp_mline_index = ParseInt(&message->sdp_mline_index);
+      } else {
+        parsed = SkipValue(0);
+      }
+      if (!parsed)
+        return Fail();
+      SkipWhitespace();
+    } while (Consume(','));
+    if (!Consume('}'))
+      return Fail();
+  }
+
+  if (has_type)
+    message->kind = SignalingMessage::kSessionDescription;
+  else if (has_sdp_mid && has_sdp_mline_index && has_candidate)
+    message->kind = SignalingMessage::kCandidate;
+  return true;
+}
+
+bool SignalingMessageReader::ParseString(std::string* out) {
+  if (!Consume('"'))
+    return false;
+  if (out)
+    out->clear();
+  while (pos_ < json_.size()) {
+    // Copy everything up to the next quote or escape in one go.
+    size_t run = pos_;
+    while (pos_ < json_.size() && json_[pos_] != '"' && json_[pos_] != '\\')
+      ++pos_;
+    if (out)
+      out->append(json_.data() + run, pos_ - run);
+    if (pos_ == json_.size())
+      break;
+    if (json_[pos_++] == '"')
+      return true;
+
+    if (pos_ == json_.size())
+      break;
+    char escaped = json_[pos_++];
+    char c;
+    switch (escaped) {
+      case '"':
+      case '\\':
+      case '/':
+        c = escaped;
+        break;
+      case 'b':
+        c = '\b';
+        break;
+      case 'f':
+        c = '\f';
+        break;
+      case 'n':
+        c = '\n';
+        break;
+      case 'r':
+        c = '\r';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'u':
+        if (!ParseUnicodeEscape(out))
+          return false;
+        continue;
+      default:
+        return false;
+    }
+    if (out)
+      out->push_back(c);
+  }
+  return false;  // Unterminated.
+}
+
+bool SignalingMessageReader::ParseUnicodeEscape(std::string* out) {
+  // `pos_` is past "\u".
+  auto read_hex4 = [this](uint32_t* value) {
+    if (json_.size() - pos_ < 4)
+      return false;
+    *value = 0;
+    for (int i = 0; i < 4; ++i) {
+      int digit = HexValue(json_[pos_ + i]);
+      if (digit < 0)
+        return false;
+      *value = (*value << 4) | digit;
+    }
+    pos_ += 4;
+    return true;
+  };
+
+  uint32_t code_point;
+  if (!read_hex4(&code_point))
+    return false;
+  if (code_point >= 0xd800 && code_point < 0xdc00) {
+    // A high surrogate, which the low one completes.
+    uint32_t low;
+    size_t saved = pos_;
+    if (json_.substr(pos_, 2) == "\\u" && (pos_ += 2, read_hex4(&low)) &&
+        low >= 0xdc00 && low < 0xe000) {
+      code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+    } else {
+      pos_ = saved;
+      code_point = 0xfffd;
+    }
+  } else if (code_point >= 0xdc00 && code_point < 0xe000) {
+    code_point = 0xfffd;
+  }
+  if (out)
+    AppendUtf8(code_point, out);
+  return true;
+}
+
+bool SignalingMessageReader::ParseInt(int* out) {
+  size_t begin = pos_;
+  bool negative = Consume('-');
+  int64_t value = 0;
+  while (pos_ < json_.size() && json_[pos_] >= '0' && json_[pos_] <= '9') {
+    value = value * 10 + (json_[pos_++] - '0');
+    if (value > std::numeric_limits<int>::max())
+      return false;
+  }
+  if (pos_ == begin + (negative ? 1 : 0))
+    return false;
+  // Only whole numbers are indices.
+  if (pos_ < json_.size() &&
+      (json_[pos_] == '.' || json_[pos_] == 'e' || json_[pos_] == 'E')) {
+    return false;
+  }
+  *out = static_cast<int>(negative ? -value : value);
+  return true;
+}
+
+bool SignalingMessageReader::SkipValue(int depth) {
+  if (depth > kMaxDepth || pos_ == json_.size())
+    return false;
+
+  char c = json_[pos_];
+  if (c == '"')
+    return ParseString(nullptr);
+
+  if (c == '{' || c == '[') {
+    char close = c == '{' ? '}' : ']';
+    ++pos_;
+    SkipWhitespace();
+    if (Consume(close))
+      return true;
+    do {
+      SkipWhitespace();
+      if (c == '{') {
+        if (!ParseString(nullptr))
+          return false;
+        SkipWhitespace();
+        if (!Consume(':'))
+          return false;
+        SkipWhitespace();
+      }
+      if (!SkipValue(depth + 1))
+        return false;
+      SkipWhitespace();
+    } while (Consume(','));
+    return Consume(close);
+  }
+
+  for (absl::string_view literal : {"true", "false", "null"}) {
+    if (json_.substr(pos_, literal.size()) == literal) {
+      pos_ += literal.size();
+      return true;
+    }
+  }
+
+  size_t begin = pos_;
+  while (pos_ < json_.size() &&
+         ((json_[pos_] >= '0' && json_[pos_] <= '9') || json_[pos_] == '-' ||
+          json_[pos_] == '+' || json_[pos_] == '.' || json_[pos_] == 'e' ||
+          json_[pos_] == 'E')) {
+    ++pos_;
+  }
+  return pos_ != begin;
+}
+
+void SignalingMessageReader::SkipWhitespace() {
+  while (pos_ < json_.size() &&
+         (json_[pos_] == ' ' || json_[pos_] == '\t' || json_[pos_] == '\n' ||
+          json_[pos_] == '\r')) {
+    ++pos_;
+  }
+}
+
+bool SignalingMessageReader::Consume(char c) {
+  if (pos_ < json_.size() && json_[pos_] == c) {
+    ++pos_;
+    return true;
+  }
+  return false;
+}
+
+bool SignalingMessageReader::Fail() {
+  failed_ = true;
+  return false;
+}
@@ -0,0 +1,87 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_SIGNALING_CODEC_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_SIGNALING_CODEC_H_
+
+#include <stddef.h>
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+
+// The two messages peers exchange through the server, as JSON objects: a
+// session description, {"type", "sdp"}, and an ICE candidate, {"sdpMid",
+// "sdpMLineIndex", "candidate"}.  They're written and read directly instead
+// of through a Json::Value tree, which costs an allocation per node and per
+// string copied out of it.
+
+struct SignalingMessage {
+  enum Kind {
+    // Neither a session description nor a complete candidate.
+    kUnknown,
+    kSessionDescription,
+    kCandidate,
+  };
+
+  Kind kind = kUnknown;
+  // Session description.
+  std::string type;
+  std::string sdp;
+  // ICE candidate.
+  std::string sdp_mid;
+  int sdp_mline_index = 0;
+  std::string candidate;
+};
+
+// Append a message to `out`, which is reserved to fit it in one allocation.
+void EncodeSessionDescription(absl::string_view type,
+                              absl::string_view sdp,
+                              std::string* out);
+void EncodeCandidate(absl::string_view sdp_mid,
+                     int sdp_mline_index,
+                     absl::string_view candidate,
+                     std::string* out);
+
+// Reads the messages out of a single message object or a batch of them, a
+// JSON array.  Members other than the ones above are skipped.  A message is
+// read into the strings of the SignalingMessage passed in, so reusing it
+// reuses their buffers.
+class SignalingMessageReader {
+ public:
+  explicit SignalingMessageReader(absl::string_view json);
+
+  // Returns false once there are no more messages, or if the JSON is
+  // malformed.
+  bool Next(SignalingMessage* message);
+
+  bool failed() const { return failed_; }
+
+ private:
+  bool ParseObject(SignalingMessage* message);
+  // `out` may be null to skip the string.
+  bool ParseString(std::string* out);
+  bool ParseInt(int* out);
+  bool SkipValue(int depth);
+  bool ParseUnicodeEscape(std::string* out);
+  void SkipWhitespace();
+  bool Consume(char c);
+  bool Fail();
+
+  const absl::string_view json_;
+  size_t pos_;
+  bool in_array_;
+  bool first_;
+  bool done_;
+  bool failed_;
+  std::string key_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_SIGNALING_CODEC_H_
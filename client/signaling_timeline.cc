@@ -0,0 +1,196 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/signaling_timeline.h"
+
+#include <string.h>
+
+#include <fstream>
+#include <utility>
+
+#include "rtc_base/logging.h"
+#include "rtc_base/strings/json.h"
+#include "rtc_base/time_utils.h"
+
+namespace {
+
+const char* const kCategoryNames[] = {"signaling", "ice", "media"};
+
+// The spans call setup is split into, each from the first event named
+// `from` to the first event named `to`.
+const struct {
+  const char* name;
+  SignalingTimeline::Category category;
+  const char* from;
+  const char* to;
+} kPhases[] = {
+    {"signaling_phase", SignalingTimeline::kSignaling, "call_started",
+     "remote_description_set"},
+    {"ice_phase", SignalingTimeline::kIce, "remote_description_set",
+     "ice_connected"},
+    {"media_phase", SignalingTimeline::kMedia, "ice_connected",
+     "first_remote_frame"},
+};
+
+}  // namespace
+
+SignalingTimeline::SignalingTimeline() : clock_(nullptr) {}
+
+SignalingTimeline::~SignalingTimeline() = default;
+
+void SignalingTimeline::BeginSession() {
+  webrtc::MutexLock lock(&lock_);
+  session_events_.clear();
+  peers_discovered_us_.clear();
+}
+
+void SignalingTimeline::MarkSession(const char* name,
+                                    const std::string& detail) {
+  webrtc::MutexLock lock(&lock_);
+  session_events_.push_back({rtc::TimeMicros(), kSignaling, name, detail});
+}
+
+void SignalingTimeline::MarkPeerDiscovered(int peer_id) {
+  webrtc::MutexLock lock(&lock_);
+  peers_discovered_us_.emplace(peer_id, rtc::TimeMicros());
+}
+
+void SignalingTimeline::ForgetPeer(int peer_id) {
+  webrtc::MutexLock lock(&lock_);
+  peers_discovered_us_.erase(peer_id);
+}
+
+void SignalingTimeline::BeginCall(int peer_id) {
+  webrtc::MutexLock lock(&lock_);
+  std::vector<Event>& call_events = calls_[peer_id];
+  call_events.clear();
+  auto discovered = peers_discovered_us_.find(peer_id);
+  if (discovered != peers_discovered_us_.end()) {
+    call_events.push_back({discovered->second, kSignaling, "peer_discovered",
+                           std::to_string(peer_id)});
+  }
+  call_events.push_back(
+      {rtc::TimeMicros(), kSignaling, "call_started", std::to_string(peer_id)});
+}
+
+bool SignalingTimeline::in_call(int peer_id) const {
+  webrtc::MutexLock lock(&lock_);
+  return calls_.find(peer_id) != calls_.end();
+}
+
+void SignalingTimeline::Mark(int peer_id,
+                             Category category,
+                             const char* name,
+                             const std::string& detail) {
+  webrtc::MutexLock lock(&lock_);
+  auto call = calls_.find(peer_id);
+  if (call == calls_.end())
+    return;
+  call->second.push_back({rtc::TimeMicros(), category, name, detail});
+}
+
+bool SignalingTimeline::EndCall(int my_id,
+                                int peer_id,
+                                const std::string& path) {
+  Json::Value events(Json::arrayValue);
+  {
+    webrtc::MutexLock lock(&lock_);
+    auto call = calls_.find(peer_id);
+    if (call == calls_.end())
+      return true;
+    std::vector<Event> call_events = std::move(call->second);
+    calls_.erase(call);
+    if (path.empty())
+      return true;
+
+    for (const std::vector<Event>* list : {&session_events_, &call_events}) {
+      for (const Event& event : *list) {
+        Json::Value jevent;
+        jevent["name"] = event.name;
+        jevent["cat"] = kCategoryNames[event.category];
+        jevent["ph"] = "i";
+        jevent["s"] = "p";
+        jevent["ts"] = Json::Int64(TraceTime(event.time_us));
+        jevent["pid"] = my_id;
+        jevent["tid"] = 0;
+        if (!event.detail.empty())
+          jevent["args"]["detail"] = event.detail;
+        events.append(jevent);
+      }
+    }
+
+    for (const auto& phase : kPhases) {
+      int64_t from_us = FindEvent(call_events, phase.from);
+      int64_t to_us = FindEvent(call_events, phase.to);
+      if (from_us == -1 || to_us < from_us)
+        continue;
+      Json::Value jphase;
+      jphase["name"] = phase.name;
+      jphase["cat"] = kCategoryNames[phase.category];
+      jphase["ph"] = "X";
+      jphase["ts"] = Json::Int64(TraceTime(from_us));
+      jphase["dur"] = Json::Int64(TraceTime(to_us) - TraceTime(from_us));
+      jphase["pid"] = my_id;
+      jphase["tid"] = 1;
+      events.append(jphase);
+    }
+  }
+
+  Json::Value trace;
+  trace["traceEvents"] = events;
+  trace["displayTimeUnit"] = "ms";
+  trace["otherData"]["peer_id"] = my_id;
+  trace["otherData"]["remote_peer_id"] = peer_id;
+  int64_t server_us = 0;
+  int64_t uncertainty_us = 0;
+  if (clock_ && clock_->ToServerTime(rtc::TimeMicros(), &server_us,
+                                     &uncertainty_us)) {
+    trace["otherData"]["time_base"] = "server";
+    trace["otherData"]["clock_uncertainty_us"] = Json::Int64(uncertainty_us);
+  } else {
+    trace["otherData"]["time_base"] = "local";
+  }
+
+  std::ofstream file(path, std::ofstream::out | std::ofstream::trunc);
+  if (!file.is_open()) {
+    RTC_LOG(LS_ERROR) << "Failed to open file: " << path;
+    return false;
+  }
+  Json::StreamWriterBuilder factory;
+  file << Json::writeString(factory, trace) << std::endl;
+  return file.good();
+}
+
+int64_t SignalingTimeline::TraceTime(int64_t time_us) const {
+  int64_t server_us = 0;
+  if (clock_ && clock_->ToServerTime(time_us, &server_us, nullptr))
+    return server_us;
+  return time_us;
+}
+
+// static
+int64_t SignalingTimeline::FindEvent(const std::vector<Event>& events,
+                                     const char* name) {
+  for (const Event& event : events) {
+    if (strcmp(event.name, name) == 0)
+      return event.time_us;
+  }
+  return -1;
+}
+
+FirstFrameMarker::FirstFrameMarker(SignalingTimeline* timeline, int peer_id)
+    : timeline_(timeline), peer_id_(peer_id), seen_(false) {}
+
+void FirstFrameMarker::OnFrame(const webrtc::VideoFrame& frame) {
+  if (!seen_.exchange(true)) {
+    timeline_->Mark(peer_id_, SignalingTimeline::kMedia,
+                    "first_remote_frame");
+  }
+}
@@ -0,0 +1,107 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_SIGNALING_TIMELINE_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_SIGNALING_TIMELINE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "api/video/video_frame.h"
+#include "api/video/video_sink_interface.h"
+#include "examples/headless_peerconnection/client/clock_offset_estimator.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread_annotations.h"
+
+// Timestamped milestones of signing in and of setting up calls, written out
+// per call as a Chrome trace event file (chrome://tracing, Perfetto).  Next
+// to the milestones the trace holds three spans that split call setup into
+// signaling (until the remote description is set), ICE (until it connects)
+// and media (until the first remote frame arrives).  Once the clock offset
+// to the signaling server is known, the trace is in the server's time base,
+// so the traces of both peers of a call line up.  Calls with several peers
+// may be under way at once; they're told apart by the remote peer's id.
+//
+// Events are marked on the main thread, the signaling thread and the thread
+// delivering remote video frames.
+class SignalingTimeline {
+ public:
+  enum Category {
+    kSignaling,
+    kIce,
+    kMedia,
+  };
+
+  SignalingTimeline();
+  ~SignalingTimeline();
+
+  // Set before any events are marked.
+  void set_clock(const ClockOffsetEstimator* clock) { clock_ = clock; }
+
+  // Starts over with the events kept for every call, the ones about signing
+  // in.
+  void BeginSession();
+  void MarkSession(const char* name, const std::string& detail = "");
+
+  // Remembered for when a call with `peer_id` begins.
+  void MarkPeerDiscovered(int peer_id);
+  void ForgetPeer(int peer_id);
+
+  void BeginCall(int peer_id);
+  bool in_call(int peer_id) const;
+  // Ignored unless in a call with `peer_id`.
+  void Mark(int peer_id,
+            Category category,
+            const char* name,
+            const std::string& detail = "");
+  // Writes the trace of the call with `peer_id` to `path` and forgets the
+  // call's events.  An empty `path` only does the latter.
+  bool EndCall(int my_id, int peer_id, const std::string& path);
+
+ private:
+  struct Event {
+    int64_t time_us;
+    Category category;
+    const char* name;
+    std::string detail;
+  };
+
+  // Time of the first event called `name`, or -1.
+  static int64_t FindEvent(const std::vector<Event>& events, const char* name);
+  // `time_us` in the time base of the trace.
+  int64_t TraceTime(int64_t time_us) const;
+
+  const ClockOffsetEstimator* clock_;
+
+  mutable webrtc::Mutex lock_;
+  std::vector<Event> session_events_ RTC_GUARDED_BY(lock_);
+  std::map<int, int64_t> peers_discovered_us_ RTC_GUARDED_BY(lock_);
+  // The events of each call, by remote peer id.
+  std::map<int, std::vector<Event>> calls_ RTC_GUARDED_BY(lock_);
+};
+
+// Marks the first frame of a remote video track on a timeline.
+class FirstFrameMarker : public rtc::VideoSinkInterface<webrtc::VideoFrame> {
+ public:
+  FirstFrameMarker(SignalingTimeline* timeline, int peer_id);
+
+  void OnFrame(const webrtc::VideoFrame& frame) override;
+
+ private:
+  SignalingTimeline* const timeline_;
+  const int peer_id_;
+  std::atomic<bool> seen_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_SIGNALING_TIMELINE_H_
@@ -0,0 +1,141 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/client/thread_placement.h"
+
+#if defined(WEBRTC_LINUX)
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "rtc_base/logging.h"
+
+namespace {
+
+// Upper bound on CPU numbers, which keeps a typo from asking for a huge
+// cpu_set_t.
+const int kMaxCpu = 1023;
+
+bool ParseCpuList(absl::string_view text, std::vector<int>* cpus) {
+  cpus->clear();
+  if (text.empty())
+    return true;
+  for (absl::string_view range : absl::StrSplit(text, ',')) {
+    int first, last;
+    size_t dash = range.find('-');
+    if (dash == absl::string_view::npos) {
+      if (!absl::SimpleAtoi(range, &first))
+        return false;
+      last = first;
+    } else if (!absl::SimpleAtoi(range.substr(0, dash), &first) ||
+               !absl::SimpleAtoi(range.substr(dash + 1), &last)) {
+      return false;
+    }
+    if (first < 0 || last < first || last > kMaxCpu)
+      return false;
+    for (int cpu = first; cpu <= last; ++cpu)
+      cpus->push_back(cpu);
+  }
+  return true;
+}
+
+bool ParsePriority(absl::string_view text, ThreadPlacement* placement) {
+  placement->priority_class = ThreadPlacement::kDefaultPriority;
+  placement->priority = 0;
+  if (text.empty())
+    return true;
+  int value;
+  if (absl::ConsumePrefix(&text, "nice:")) {
+    if (!absl::SimpleAtoi(text, &value) || value < -20 || value > 19)
+      return false;
+    placement->priority_class = ThreadPlacement::kNice;
+  } else if (absl::ConsumePrefix(&text, "rt:")) {
+    if (!absl::SimpleAtoi(text, &value) || value < 1 || value > 99)
+      return false;
+    placement->priority_class = ThreadPlacement::kRealtime;
+  } else {
+    return false;
+  }
+  placement->priority = value;
+  return true;
+}
+
+}  // namespace
+
+bool ParseThreadPlacement(absl::string_view cpus,
+                          absl::string_view priority,
+                          ThreadPlacement* placement) {
+  return ParseCpuList(cpus, &placement->cpus) &&
+         ParsePriority(priority, placement);
+}
+
+#if defined(WEBRTC_LINUX)
+
+bool PlaceCurrentThread(absl::string_view name,
+                        const ThreadPlacement& placement) {
+  bool ok = true;
+  if (!placement.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : placement.cpus)
+      CPU_SET(cpu, &set);
+    // 0 is the calling thread, not the whole process.
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      RTC_LOG(LS_ERROR) << "Failed to pin the " << name
+                        << " thread: " << strerror(errno);
+      ok = false;
+    }
+  }
+
+  if (placement.priority_class == ThreadPlacement::kNice) {
+    // Linux keeps a nice value per thread, addressed by its thread id.
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, tid, placement.priority) != 0) {
+      RTC_LOG(LS_ERROR) << "Failed to set the nice value of the " << name
+                        << " thread: " << strerror(errno);
+      ok = false;
+    }
+  } else if (placement.priority_class == ThreadPlacement::kRealtime) {
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = placement.priority;
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0) {
+      RTC_LOG(LS_ERROR) << "Failed to make the " << name
+                        << " thread real-time: " << strerror(error);
+      ok = false;
+    }
+  }
+
+  return ok;
+}
+
+#else
+
+bool PlaceCurrentThread(absl::string_view name,
+                        const ThreadPlacement& placement) {
+  if (placement.cpus.empty() &&
+      placement.priority_class == ThreadPlacement::kDefaultPriority) {
+    return true;
+  }
+  RTC_LOG(LS_WARNING) << "Thread placement isn't supported on this platform; "
+                      << "the " << name << " thread is left as it is.";
+  return false;
+}
+
+#endif  // defined(WEBRTC_LINUX)
@@ -0,0 +1,48 @@
+/*
+ *  Copyright 2012 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_CLIENT_THREAD_PLACEMENT_H_
+#define EXAMPLES_PEERCONNECTION_CLIENT_THREAD_PLACEMENT_H_
+
+#include <vector>
+
+#include "absl/strings/string_view.h"
+
+// Which CPUs a thread runs on and at what priority.  The defaults leave the
+// thread as it was created.
+struct ThreadPlacement {
+  enum Priority {
+    kDefaultPriority,
+    // `priority` is a nice value, -20 to 19.
+    kNice,
+    // `priority` is a SCHED_FIFO priority, 1 to 99.
+    kRealtime,
+  };
+
+  // Empty to run on any CPU.
+  std::vector<int> cpus;
+  Priority priority_class = kDefaultPriority;
+  int priority = 0;
+};
+
+// Fills in `placement` from a CPU list like "0-3,6" and a priority like
+// "nice:-5" or "rt:10".  Either may be empty.  Returns false if one of them
+// is malformed or out of range.
+bool ParseThreadPlacement(absl::string_view cpus,
+                          absl::string_view priority,
+                          ThreadPlacement* placement);
+
+// Applies `placement` to the calling thread.  Returns false, after logging
+// why, if the system refused part of it; raising the priority usually takes
+// privileges (CAP_SYS_NICE) the process may not have.
+bool PlaceCurrentThread(absl::string_view name,
+                        const ThreadPlacement& placement);
+
+#endif  // EXAMPLES_PEERCONNECTION_CLIENT_THREAD_PLACEMENT_H_
@@ -0,0 +1,518 @@
+/*
+ *  Copyright 2011 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+// Replays a request trace captured with the server's --capture_file flag
+// against a freshly started server and reports throughput and latency.
+//
+// Peer ids are assigned by the server, so the ids in the trace are mapped to
+// the ids the replayed sign-ins receive.  A request that refers to a peer
+// whose sign-in hasn't been answered yet is held back until it has.
+//
+// Requests the trace has on one connection are replayed on one connection
+// too, kept alive in between, so that the server sees the same connection
+// reuse.  Such a request is held back until the one before it on its
+// connection has been answered.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "examples/headless_peerconnection/server/request_trace.h"
+
+ABSL_FLAG(std::string, trace, "", "The request trace to replay.");
+ABSL_FLAG(std::string, server, "localhost", "The server to replay against.");
+ABSL_FLAG(int, port, 8888, "The port the server is listening on.");
+ABSL_FLAG(double,
+          speed,
+          1.0,
+          "Replay speed relative to the capture, e.g. 2 replays twice as "
+          "fast.  0 sends every request as soon as possible.");
+ABSL_FLAG(int,
+          max_connections,
+          900,
+          "Maximum number of requests in flight, including hanging GETs.");
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Connection {
+  int fd = -1;
+  // The connection_id of the trace records replayed on this connection.
+  uint32_t trace_id = 0;
+  // A request is in flight; otherwise the connection is kept alive for the
+  // next request of `trace_id`.
+  bool busy = false;
+  // Index of the trace record this connection replays.
+  size_t record = 0;
+  bool is_wait = false;
+  bool keep_alive = false;
+  Clock::time_point sent_at;
+  std::string request;
+  size_t request_sent = 0;
+  std::string response;
+  // A streamed "/wait" response has its chunks taken out of `response` as
+  // they arrive, leaving the headers.
+  bool streamed = false;
+};
+
+struct ReplayStats {
+  size_t sent = 0;
+  size_t completed = 0;
+  size_t failed = 0;
+  size_t waits_answered = 0;
+  // Latencies of all requests other than hanging GETs, in microseconds.
+  std::vector<int64_t> latencies_us;
+};
+
+class Replayer {
+ public:
+  Replayer(std::vector<TraceRecord> records,
+           const sockaddr_in& server,
+           double speed,
+           size_t max_connections)
+      : records_(std::move(records)),
+        server_(server),
+        speed_(speed),
+        max_connections_(max_connections) {}
+
+  ReplayStats Run();
+
+ private:
+  // Rewrites the peer_id and to arguments of `path` from trace ids to the ids
+  // of this replay.  Returns false if an id belongs to a sign-in that is
+  // still in flight.
+  bool MapPeerIds(const std::string& path, std::string* mapped) const;
+  static bool Replayable(const TraceRecord& record);
+  // Returns false if the request has to wait for a sign-in to be answered,
+  // or for the previous request on its connection.
+  bool Issue(size_t index);
+  // Marks the records followed by another one on the same connection.
+  void FindKeptAliveRecords();
+  void OnWritable(Connection* c);
+  void OnReadable(Connection* c);
+  // True once the headers and Content-Length bytes of body have arrived.
+  static bool ResponseComplete(const std::string& response);
+  static bool IsChunked(const std::string& response);
+  // Counts each complete chunk of a streamed response as an answered wait.
+  // Returns true once the terminating chunk has arrived.
+  bool TakeChunks(Connection* c);
+  // Accounts for the response and closes the connection, unless it's kept
+  // alive for the next request.  `closed` is set if the server closed it.
+  void Complete(Connection* c, bool closed);
+  static void Close(Connection* c);
+  Clock::time_point DueTime(size_t index) const;
+
+  std::vector<TraceRecord> records_;
+  // Whether a later record was captured on the same connection as each one.
+  std::vector<bool> kept_alive_;
+  sockaddr_in server_;
+  double speed_;
+  size_t max_connections_;
+  Clock::time_point start_;
+  std::vector<Connection> connections_;
+  std::map<int32_t, int32_t> peer_ids_;
+  std::set<int32_t> pending_sign_ins_;
+  ReplayStats stats_;
+};
+
+Clock::time_point Replayer::DueTime(size_t index) const {
+  if (speed_ <= 0)
+    return start_;
+  return start_ + std::chrono::microseconds(static_cast<int64_t>(
+                      records_[index].timestamp_us / speed_));
+}
+
+bool Replayer::MapPeerIds(const std::string& path, std::string* mapped) const {
+  static const char* kIdArguments[] = {"peer_id=", "to="};
+  size_t args = path.find('?');
+  if (args == std::string::npos) {
+    *mapped = path;
+    return true;
+  }
+
+  mapped->assign(path, 0, args + 1);
+  size_t pos = args + 1;
+  while (pos < path.length()) {
+    size_t end = path.find('&', pos);
+    if (end == std::string::npos)
+      end = path.length();
+    std::string arg(path, pos, end - pos);
+    for (const char* name : kIdArguments) {
+      size_t name_length = strlen(name);
+      if (arg.compare(0, name_length, name) != 0)
+        continue;
+      int32_t id = atoi(arg.c_str() + name_length);
+      if (pending_sign_ins_.count(id))
+        return false;
+      std::map<int32_t, int32_t>::const_iterator found = peer_ids_.find(id);
+      if (found != peer_ids_.end())
+        arg = name + std::to_string(found->second);
+    }
+    *mapped += arg;
+    if (end < path.length())
+      *mapped += '&';
+    pos = end + 1;
+  }
+  return true;
+}
+
+bool Replayer::Replayable(const TraceRecord& record) {
+  // Replaying /quit would shut the server down under the remaining requests.
+  return TraceMethodName(record.method) && record.path != "/quit";
+}
+
+void Replayer::FindKeptAliveRecords() {
+  kept_alive_.assign(records_.size(), false);
+  std::map<uint32_t, size_t> last;
+  for (size_t i = 0; i < records_.size(); ++i) {
+    if (!Replayable(records_[i]))
+      continue;
+    std::map<uint32_t, size_t>::iterator found =
+        last.find(records_[i].connection_id);
+    if (found != last.end())
+      kept_alive_[found->second] = true;
+    last[records_[i].connection_id] = i;
+  }
+}
+
+bool Replayer::Issue(size_t index) {
+  const TraceRecord& record = records_[index];
+  std::vector<Connection>::iterator open =
+      std::find_if(connections_.begin(), connections_.end(),
+                   [&record](const Connection& c) {
+                     return c.fd != -1 && c.trace_id == record.connection_id;
+                   });
+  if (open != connections_.end() && open->busy)
+    return false;
+  std::string path;
+  if (!MapPeerIds(record.path, &path))
+    return false;
+
+  Connection fresh;
+  Connection& c = open != connections_.end() ? *open : fresh;
+  c.trace_id = record.connection_id;
+  c.busy = true;
+  c.record = index;
+  c.is_wait = path.compare(0, 6, "/wait?") == 0;
+  c.keep_alive = kept_alive_[index];
+  c.request = std::string(TraceMethodName(record.method)) + " " + path +
+              " HTTP/1.0\r\n";
+  if (c.keep_alive)
+    c.request += "Connection: keep-alive\r\n";
+  if (!record.body.empty()) {
+    c.request += "Content-Length: " + std::to_string(record.body.length()) +
+                 "\r\nContent-Type: text/plain\r\n";
+  }
+  c.request += "\r\n" + record.body;
+  c.request_sent = 0;
+  c.response.clear();
+  c.streamed = false;
+  c.sent_at = Clock::now();
+
+  if (c.fd == -1) {
+    c.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c.fd < 0) {
+      ++stats_.failed;
+      return true;
+    }
+    fcntl(c.fd, F_SETFL, fcntl(c.fd, F_GETFL, 0) | O_NONBLOCK);
+    if (connect(c.fd, reinterpret_cast<const sockaddr*>(&server_),
+                sizeof(server_)) < 0 &&
+        errno != EINPROGRESS) {
+      close(c.fd);
+      ++stats_.failed;
+      return true;
+    }
+    connections_.push_back(c);
+  }
+
+  if (record.peer_id != -1)
+    pending_sign_ins_.insert(record.peer_id);
+  ++stats_.sent;
+  return true;
+}
+
+void Replayer::OnWritable(Connection* c) {
+  while (c->request_sent < c->request.length()) {
+    ssize_t sent = send(c->fd, c->request.data() + c->request_sent,
+                        c->request.length() - c->request_sent, MSG_NOSIGNAL);
+    if (sent <= 0)
+      return;
+    c->request_sent += sent;
+  }
+}
+
+void Replayer::OnReadable(Connection* c) {
+  char buffer[0xffff];
+  ssize_t bytes;
+  while ((bytes = recv(c->fd, buffer, sizeof(buffer), 0)) > 0)
+    c->response.append(buffer, bytes);
+  bool closed = bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+
+  if (!c->busy) {
+    // The server timed out a connection kept alive for a later request,
+    // which then goes out on a new one.
+    if (closed)
+      Close(c);
+    return;
+  }
+  // The server leaves closing the connection to the client, so a response
+  // is usually complete long before the connection is.  A streamed "/wait"
+  // stays open for as long as the server keeps the stream going.
+  bool done;
+  if (IsChunked(c->response)) {
+    c->streamed = true;
+    done = TakeChunks(c);
+  } else {
+    done = ResponseComplete(c->response);
+  }
+  if (closed || done)
+    Complete(c, closed);
+}
+
+bool Replayer::IsChunked(const std::string& response) {
+  size_t end_of_headers = response.find("\r\n\r\n");
+  if (end_of_headers == std::string::npos)
+    return false;
+  size_t found = response.find("\r\nTransfer-Encoding: chunked\r\n");
+  return found != std::string::npos && found < end_of_headers;
+}
+
+bool Replayer::TakeChunks(Connection* c) {
+  size_t start = c->response.find("\r\n\r\n") + 4;
+  while (true) {
+    size_t end_of_size = c->response.find("\r\n", start);
+    if (end_of_size == std::string::npos)
+      return false;
+    size_t size = strtoul(&c->response[start], NULL, 16);
+    if (size == 0)
+      return true;
+    size_t end = end_of_size + 2 + size + 2;
+    if (c->response.length() < end)
+      return false;
+    ++stats_.waits_answered;
+    c->response.erase(start, end - start);
+  }
+}
+
+bool Replayer::ResponseComplete(const std::string& response) {
+  size_t end_of_headers = response.find("\r\n\r\n");
+  if (end_of_headers == std::string::npos)
+    return false;
+  static const char kContentLength[] = "\r\nContent-Length: ";
+  size_t found = response.find(kContentLength);
+  if (found == std::string::npos || found > end_of_headers)
+    return true;
+  size_t length = strtoul(&response[found + strlen(kContentLength)], NULL, 10);
+  return response.length() >= end_of_headers + 4 + length;
+}
+
+void Replayer::Complete(Connection* c, bool closed) {
+  const TraceRecord& record = records_[c->record];
+  int status = -1;
+  size_t space = c->response.find(' ');
+  if (space != std::string::npos)
+    status = atoi(c->response.c_str() + space + 1);
+
+  if (record.peer_id != -1) {
+    pending_sign_ins_.erase(record.peer_id);
+    static const char kPragma[] = "\r\nPragma: ";
+    size_t found = c->response.find(kPragma);
+    if (status == 200 && found != std::string::npos)
+      peer_ids_[record.peer_id] = atoi(&c->response[found + strlen(kPragma)]);
+  }
+
+  if (status != 200) {
+    ++stats_.failed;
+  } else if (c->is_wait) {
+    // The chunks of a stream were counted as they came.
+    if (!c->streamed)
+      ++stats_.waits_answered;
+  } else {
+    ++stats_.completed;
+    stats_.latencies_us.push_back(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                              c->sent_at)
+            .count());
+  }
+
+  c->busy = false;
+  if (closed || !c->keep_alive ||
+      c->response.find("\r\nConnection: close\r\n") != std::string::npos) {
+    Close(c);
+  }
+}
+
+void Replayer::Close(Connection* c) {
+  close(c->fd);
+  c->fd = -1;
+}
+
+ReplayStats Replayer::Run() {
+  FindKeptAliveRecords();
+  start_ = Clock::now();
+  size_t next = 0;
+  while (true) {
+    bool blocked = false;
+    while (next < records_.size() && connections_.size() < max_connections_ &&
+           DueTime(next) <= Clock::now()) {
+      if (!Replayable(records_[next])) {
+        ++next;
+        continue;
+      }
+      if (!Issue(next)) {
+        blocked = true;
+        break;
+      }
+      ++next;
+    }
+
+    size_t active = 0;
+    for (const Connection& c : connections_) {
+      if (c.busy && !c.is_wait)
+        ++active;
+    }
+    if (next == records_.size() && active == 0)
+      break;
+
+    int timeout_ms = 10;
+    if (next < records_.size() && !blocked) {
+      int64_t until_due = std::chrono::duration_cast<std::chrono::milliseconds>(
+                              DueTime(next) - Clock::now())
+                              .count();
+      timeout_ms = static_cast<int>(std::max<int64_t>(
+          0, std::min<int64_t>(until_due, timeout_ms)));
+    }
+
+    std::vector<pollfd> fds(connections_.size());
+    for (size_t i = 0; i < connections_.size(); ++i) {
+      const Connection& c = connections_[i];
+      fds[i].fd = c.fd;
+      fds[i].events = POLLIN;
+      if (c.request_sent < c.request.length())
+        fds[i].events |= POLLOUT;
+      fds[i].revents = 0;
+    }
+    if (poll(fds.data(), fds.size(), timeout_ms) < 0 && errno != EINTR) {
+      perror("poll");
+      break;
+    }
+
+    for (size_t i = 0; i < connections_.size(); ++i) {
+      Connection& c = connections_[i];
+      if (fds[i].revents & POLLOUT)
+        OnWritable(&c);
+      if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+        OnReadable(&c);
+    }
+    connections_.erase(
+        std::remove_if(connections_.begin(), connections_.end(),
+                       [](const Connection& c) { return c.fd == -1; }),
+        connections_.end());
+  }
+
+  for (Connection& c : connections_)
+    close(c.fd);
+  connections_.clear();
+  return stats_;
+}
+
+int64_t Percentile(const std::vector<int64_t>& sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+  return sorted[index];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  absl::SetProgramUsageMessage(
+      "Example usage: ./headless_peerconnection_replay --trace=capture.bin "
+      "--server=localhost --port=8888 --speed=4\n");
+  absl::ParseCommandLine(argc, argv);
+
+  RequestTraceReader reader;
+  const std::string trace = absl::GetFlag(FLAGS_trace);
+  if (trace.empty() || !reader.Open(trace)) {
+    printf("Error: could not open trace \"%s\".\n", trace.c_str());
+    return -1;
+  }
+  std::vector<TraceRecord> records;
+  TraceRecord record;
+  while (reader.Read(&record))
+    records.push_back(record);
+
+  int port = absl::GetFlag(FLAGS_port);
+  if ((port < 1) || (port > 65535)) {
+    printf("Error: %i is not a valid port.\n", port);
+    return -1;
+  }
+
+  const std::string server = absl::GetFlag(FLAGS_server);
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = NULL;
+  if (getaddrinfo(server.c_str(), NULL, &hints, &result) != 0 || !result) {
+    printf("Error: could not resolve %s.\n", server.c_str());
+    return -1;
+  }
+  sockaddr_in address = *reinterpret_cast<sockaddr_in*>(result->ai_addr);
+  address.sin_port = htons(port);
+  freeaddrinfo(result);
+
+  double speed = absl::GetFlag(FLAGS_speed);
+  int max_connections = absl::GetFlag(FLAGS_max_connections);
+  if (speed < 0 || max_connections < 1) {
+    printf("Error: invalid --speed or --max_connections.\n");
+    return -1;
+  }
+
+  printf("Replaying %zu requests from %s\n", records.size(), trace.c_str());
+  Clock::time_point start = Clock::now();
+  Replayer replayer(std::move(records), address, speed, max_connections);
+  ReplayStats stats = replayer.Run();
+  double elapsed =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::sort(stats.latencies_us.begin(), stats.latencies_us.end());
+  printf("Sent:           %zu\n", stats.sent);
+  printf("Completed:      %zu\n", stats.completed);
+  printf("Waits answered: %zu\n", stats.waits_answered);
+  printf("Failed:         %zu\n", stats.failed);
+  printf("Elapsed:        %.3f s\n", elapsed);
+  printf("Throughput:     %.1f requests/s\n",
+         elapsed > 0 ? stats.completed / elapsed : 0.0);
+  printf("Latency (ms):   p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+         Percentile(stats.latencies_us, 0.5) / 1000.0,
+         Percentile(stats.latencies_us, 0.9) / 1000.0,
+         Percentile(stats.latencies_us, 0.99) / 1000.0,
+         Percentile(stats.latencies_us, 1.0) / 1000.0);
+  return 0;
+}
@@ -8,7 +8,7 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 
-#include "examples/peerconnection/server/data_socket.h"
+#include "examples/headless_peerconnection/server/data_socket.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,11 +17,13 @@
 #include <unistd.h>
 #endif
 
-#include "examples/peerconnection/server/utils.h"
+#include "examples/headless_peerconnection/server/utils.h"
 #include "rtc_base/checks.h"
 
 static const char kHeaderTerminator[] = "\r\n\r\n";
 static const int kHeaderTerminatorLength = sizeof(kHeaderTerminator) - 1;
+static const char kBadRequest[] = "400 Bad Request";
+static const char kPayloadTooLarge[] = "413 Payload Too Large";
 
 // static
 const char DataSocket::kCrossOriginAllowHeaders[] =
@@ -64,10 +66,22 @@ void SocketBase::Close() {
   }
 }
 
+void SocketBase::Shutdown() {
+  if (socket_ != INVALID_SOCKET) {
+#if defined(WIN32)
+    shutdown(socket_, SD_BOTH);
+#else
+    shutdown(socket_, SHUT_RDWR);
+#endif
+  }
+}
+
 //
 // DataSocket
 //
 
+uint32_t DataSocket::s_socket_id_ = 0;
+
 std::string DataSocket::request_arguments() const {
   size_t args = request_path_.find('?');
   if (args != std::string::npos)
@@ -83,7 +97,8 @@ bool DataSocket::PathEquals(const char* path) const {
   return request_path_.compare(path) == 0;
 }
 
-bool DataSocket::OnDataAvailable(bool* close_socket) {
+bool DataSocket::OnDataAvailable(const RequestLimits& limits,
+                                 bool* close_socket) {
   RTC_DCHECK(valid());
   char buffer[0xfff] = {0};
   int bytes = recv(socket_, buffer, sizeof(buffer), 0);
@@ -103,17 +118,66 @@ bool DataSocket::OnDataAvailable(bool* close_socket) {
       data_.append(buffer, bytes);
     }
   } else {
+    // On a kept-alive connection the header deadline starts with the first
+    // byte of the request rather than when the previous one was answered.
+    if (request_headers_.empty())
+      request_started_ = Clock::now();
     request_headers_.append(buffer, bytes);
     size_t found = request_headers_.find(kHeaderTerminator);
     if (found != std::string::npos) {
       data_ = request_headers_.substr(found + kHeaderTerminatorLength);
       request_headers_.resize(found + kHeaderTerminatorLength);
+      headers_received_at_ = Clock::now();
       ret = ParseHeaders();
+      if (!ret)
+        error_status_ = kBadRequest;
+    }
+    if (limits.max_header_size &&
+        request_headers_.length() > limits.max_header_size) {
+      error_status_ = kPayloadTooLarge;
     }
   }
+
+  // Checking the declared length turns oversized bodies away before they're
+  // read, checking the data catches clients that send more than they declared.
+  if (limits.max_body_size && (content_length_ > limits.max_body_size ||
+                               data_.length() > limits.max_body_size)) {
+    error_status_ = kPayloadTooLarge;
+  }
+
+  // Clear() readies the connection for the next request by dropping what's
+  // left of the current one, so a request pipelined behind it would be lost.
+  // Such a connection is closed after the reply instead.
+  size_t request_data_length = method_ == POST ? content_length_ : 0;
+  if (headers_received() && data_.length() > request_data_length) {
+    data_.resize(request_data_length);
+    keep_alive_ = false;
+    pipelined_ = true;
+  }
+
+  if (error_status_) {
+    // The connection is closed after the error response.
+    keep_alive_ = false;
+    return false;
+  }
   return ret;
 }
 
+DataSocket::Clock::time_point DataSocket::deadline(
+    const RequestLimits& limits) const {
+  if (idle()) {
+    if (limits.idle_timeout.count())
+      return request_started_ + limits.idle_timeout;
+  } else if (!headers_received()) {
+    if (limits.header_timeout.count())
+      return request_started_ + limits.header_timeout;
+  } else if (!data_received()) {
+    if (limits.body_timeout.count())
+      return headers_received_at_ + limits.body_timeout;
+  }
+  return Clock::time_point::max();
+}
+
 bool DataSocket::Send(const std::string& data) const {
   return send(socket_, data.data(), static_cast<int>(data.length()), 0) !=
          SOCKET_ERROR;
@@ -126,20 +190,62 @@ bool DataSocket::Send(const std::string& status,
                       const std::string& data) const {
   RTC_DCHECK(valid());
   RTC_DCHECK(!status.empty());
+  const char* connection = NULL;
+  if (keep_alive_)
+    connection = "keep-alive";
+  else if (connection_close)
+    connection = "close";
+  return Send(
+      BuildResponse(status, connection, content_type, extra_headers, &data));
+}
+
+bool DataSocket::StartChunkedResponse(const std::string& status,
+                                      const std::string& content_type,
+                                      const std::string& extra_headers) {
+  RTC_DCHECK(valid());
+  RTC_DCHECK(!streaming_);
+  streaming_ = true;
+  return Send(
+      BuildResponse(status, NULL, content_type, extra_headers, NULL));
+}
+
+bool DataSocket::SendChunk(const std::string& status,
+                           const std::string& content_type,
+                           const std::string& extra_headers,
+                           const std::string& data) const {
+  RTC_DCHECK(valid());
+  RTC_DCHECK(streaming_);
+  std::string message =
+      BuildResponse(status, NULL, content_type, extra_headers, &data);
+  char size[32];
+  snprintf(size, sizeof(size), "%zx\r\n", message.length());
+  return Send(size + message + "\r\n");
+}
+
+// static
+std::string DataSocket::BuildResponse(const std::string& status,
+                                      const char* connection,
+                                      const std::string& content_type,
+                                      const std::string& extra_headers,
+                                      const std::string* data) {
   std::string buffer("HTTP/1.1 " + status + "\r\n");
 
   buffer +=
       "Server: PeerConnectionTestServer/0.1\r\n"
       "Cache-Control: no-cache\r\n";
 
-  if (connection_close)
-    buffer += "Connection: close\r\n";
+  if (connection)
+    buffer += "Connection: " + std::string(connection) + "\r\n";
 
   if (!content_type.empty())
     buffer += "Content-Type: " + content_type + "\r\n";
 
-  buffer +=
-      "Content-Length: " + int2str(static_cast<int>(data.size())) + "\r\n";
+  if (data) {
+    buffer +=
+        "Content-Length: " + int2str(static_cast<int>(data->size())) + "\r\n";
+  } else {
+    buffer += "Transfer-Encoding: chunked\r\n";
+  }
 
   if (!extra_headers.empty()) {
     buffer += extra_headers;
@@ -149,18 +255,25 @@ bool DataSocket::Send(const std::string& status,
   buffer += kCrossOriginAllowHeaders;
 
   buffer += "\r\n";
-  buffer += data;
+  if (data)
+    buffer += *data;
 
-  return Send(buffer);
+  return buffer;
 }
 
 void DataSocket::Clear() {
   method_ = INVALID;
   content_length_ = 0;
+  keep_alive_ = false;
+  streaming_ = false;
+  pipelined_ = false;
   content_type_.clear();
   request_path_.clear();
   request_headers_.clear();
   data_.clear();
+  error_status_ = NULL;
+  reused_ = true;
+  request_started_ = Clock::now();
 }
 
 bool DataSocket::ParseHeaders() {
@@ -176,6 +289,9 @@ bool DataSocket::ParseHeaders() {
   RTC_DCHECK_NE(method_, INVALID);
   RTC_DCHECK(!request_path_.empty());
 
+  static const char kKeepAlive[] = "\r\nConnection: keep-alive\r\n";
+  keep_alive_ = request_headers_.find(kKeepAlive, i) != std::string::npos;
+
   if (method_ == POST) {
     const char* headers = request_headers_.data() + i + 2;
     size_t len = request_headers_.length() - i - 2;
@@ -238,7 +354,11 @@ bool DataSocket::ParseContentLengthAndType(const char* headers, size_t length) {
         headers += ARRAYSIZE(kContentLength) - 1;
         while (headers[0] == ' ')
           ++headers;
-        content_length_ = atoi(headers);
+        const char* length_end = strstr(headers, "\r\n");
+        if (length_end == NULL)
+          length_end = end;
+        if (!ParseContentLength(headers, length_end, &content_length_))
+          return false;
       } else if ((headers + ARRAYSIZE(kContentType)) < end &&
                  strncmp(headers, kContentType, ARRAYSIZE(kContentType) - 1) ==
                      0) {
@@ -261,6 +381,28 @@ bool DataSocket::ParseContentLengthAndType(const char* headers, size_t length) {
   return !content_type_.empty() && content_length_ != 0;
 }
 
+// static
+bool DataSocket::ParseContentLength(const char* begin,
+                                    const char* end,
+                                    size_t* length) {
+  while (end > begin && end[-1] == ' ')
+    --end;
+  if (begin == end)
+    return false;
+
+  size_t value = 0;
+  for (const char* p = begin; p < end; ++p) {
+    if (*p < '0' || *p > '9')
+      return false;
+    size_t digit = *p - '0';
+    if (value > (SIZE_MAX - digit) / 10)
+      return false;
+    value = value * 10 + digit;
+  }
+  *length = value;
+  return true;
+}
+
 //
 // ListeningSocket
 //
@@ -286,8 +428,9 @@ bool ListeningSocket::Listen(unsigned short port) {
   return listen(socket_, 5) != SOCKET_ERROR;
 }
 
-DataSocket* ListeningSocket::Accept() const {
+DataSocket* ListeningSocket::Accept(ObjectPool<DataSocket>* pool) const {
   RTC_DCHECK(valid());
+  RTC_DCHECK(pool);
   struct sockaddr_in addr = {0};
   socklen_t size = sizeof(addr);
   NativeSocket client =
@@ -295,5 +438,5 @@ DataSocket* ListeningSocket::Accept() const {
   if (client == INVALID_SOCKET)
     return NULL;
 
-  return new DataSocket(client);
+  return pool->New(client, addr.sin_addr.s_addr);
 }
@@ -31,8 +31,14 @@ typedef int NativeSocket;
 #endif
 #endif
 
+#include <stdint.h>
+
+#include <chrono>
 #include <string>
 
+#include "examples/headless_peerconnection/server/intrusive_list.h"
+#include "examples/headless_peerconnection/server/object_pool.h"
+
 class SocketBase {
  public:
   SocketBase() : socket_(INVALID_SOCKET) {}
@@ -46,13 +52,30 @@ class SocketBase {
 
   bool Create();
   void Close();
+  // Shuts the connection down in both directions but keeps the socket open,
+  // so that whoever owns it sees it become readable and closes it.
+  void Shutdown();
 
  protected:
   NativeSocket socket_;
 };
 
-// Represents an HTTP server socket.
-class DataSocket : public SocketBase {
+// Bounds on the requests a DataSocket accepts.  Zero means unlimited.
+struct RequestLimits {
+  size_t max_header_size = 0;
+  size_t max_body_size = 0;
+  // Time allowed for the headers, counted from the first byte of the
+  // request, or from the connection for its first request.
+  std::chrono::milliseconds header_timeout{0};
+  // Time allowed for the body, counted from the end of the headers.
+  std::chrono::milliseconds body_timeout{0};
+  // Time a kept-alive connection may wait for its next request.
+  std::chrono::milliseconds idle_timeout{0};
+};
+
+// Represents an HTTP server socket.  The server keeps its open sockets in an
+// IntrusiveList so that closing one doesn't shift the others around.
+class DataSocket : public SocketBase, public IntrusiveListNode<DataSocket> {
  public:
   enum RequestMethod {
     INVALID,
@@ -61,8 +84,21 @@ class DataSocket : public SocketBase {
     OPTIONS,
   };
 
-  explicit DataSocket(NativeSocket socket)
-      : SocketBase(socket), method_(INVALID), content_length_(0) {}
+  typedef std::chrono::steady_clock Clock;
+
+  // `remote_address` is the peer's IPv4 address in network byte order.
+  DataSocket(NativeSocket socket, uint32_t remote_address)
+      : SocketBase(socket),
+        id_(++s_socket_id_),
+        remote_address_(remote_address),
+        method_(INVALID),
+        content_length_(0),
+        keep_alive_(false),
+        streaming_(false),
+        pipelined_(false),
+        reused_(false),
+        error_status_(NULL),
+        request_started_(Clock::now()) {}
 
   ~DataSocket() {}
 
@@ -70,6 +106,11 @@ class DataSocket : public SocketBase {
 
   bool headers_received() const { return method_ != INVALID; }
 
+  // Identifies the connection in logs and request traces.
+  uint32_t id() const { return id_; }
+
+  uint32_t remote_address() const { return remote_address_; }
+
   RequestMethod method() const { return method_; }
 
   const std::string& request_path() const { return request_path_; }
@@ -81,6 +122,23 @@ class DataSocket : public SocketBase {
 
   size_t content_length() const { return content_length_; }
 
+  // True if the client asked for the connection to be kept open for further
+  // requests with a "Connection: keep-alive" header.
+  bool keep_alive() const { return keep_alive_; }
+
+  // True once StartChunkedResponse() has been called.
+  bool streaming() const { return streaming_; }
+
+  // True if bytes of a further request arrived along with this one.  They
+  // are dropped, and the connection isn't kept alive after the reply.
+  bool pipelined() const { return pipelined_; }
+
+  // True while a kept-alive connection waits for the first byte of its next
+  // request.  An idle connection that times out is closed without a reply.
+  bool idle() const {
+    return reused_ && !headers_received() && request_headers_.empty();
+  }
+
   bool request_received() const {
     return headers_received() && (method_ != POST || data_received());
   }
@@ -93,8 +151,17 @@ class DataSocket : public SocketBase {
   bool PathEquals(const char* path) const;
 
   // Called when we have received some data from clients.
-  // Returns false if an error occurred.
-  bool OnDataAvailable(bool* close_socket);
+  // Returns false if an error occurred.  If the request broke one of the
+  // `limits`, error_status() holds the response to send before closing.
+  bool OnDataAvailable(const RequestLimits& limits, bool* close_socket);
+
+  // The HTTP status to reply with when the request was rejected, or NULL.
+  const char* error_status() const { return error_status_; }
+
+  // Returns the time by which the next request must start, or the headers or
+  // the body of the current request must have arrived, or
+  // Clock::time_point::max() if nothing is pending.
+  Clock::time_point deadline(const RequestLimits& limits) const;
 
   // Send a raw buffer of bytes.
   bool Send(const std::string& data) const;
@@ -102,8 +169,9 @@ class DataSocket : public SocketBase {
   // Send an HTTP response.  The `status` should start with a valid HTTP
   // response code, followed by a string.  E.g. "200 OK".
   // If `connection_close` is set to true, an extra "Connection: close" HTTP
-  // header will be included.  `content_type` is the mime content type, not
-  // including the "Content-Type: " string.
+  // header will be included, unless the client asked for keep-alive, in which
+  // case "Connection: keep-alive" is sent instead.  `content_type` is the
+  // mime content type, not including the "Content-Type: " string.
   // `extra_headers` should be either empty or a list of headers where each
   // header terminates with "\r\n".
   // `data` is the body of the message.  It's length will be specified via
@@ -114,6 +182,18 @@ class DataSocket : public SocketBase {
             const std::string& extra_headers,
             const std::string& data) const;
 
+  // Starts a response with a chunked body that's kept open for SendChunk().
+  bool StartChunkedResponse(const std::string& status,
+                            const std::string& content_type,
+                            const std::string& extra_headers);
+
+  // Sends a complete HTTP response, as Send() would format it, as the next
+  // chunk of the response started with StartChunkedResponse().
+  bool SendChunk(const std::string& status,
+                 const std::string& content_type,
+                 const std::string& extra_headers,
+                 const std::string& data) const;
+
   // Clears all held state and prepares the socket for receiving a new request.
   void Clear();
 
@@ -130,13 +210,39 @@ class DataSocket : public SocketBase {
   // Determines the length of the body and it's mime type.
   bool ParseContentLengthAndType(const char* headers, size_t length);
 
+  // Formats an HTTP response.  `connection` is the value of the Connection
+  // header, if any.  If `data` is NULL the body is sent in chunks later.
+  static std::string BuildResponse(const std::string& status,
+                                   const char* connection,
+                                   const std::string& content_type,
+                                   const std::string& extra_headers,
+                                   const std::string* data);
+
+  // Parses the decimal value of a Content-Length header.  Unlike atoi, this
+  // rejects values that are empty, signed or too large to represent.
+  static bool ParseContentLength(const char* begin,
+                                 const char* end,
+                                 size_t* length);
+
  protected:
+  uint32_t id_;
+  uint32_t remote_address_;
   RequestMethod method_;
   size_t content_length_;
+  bool keep_alive_;
+  bool streaming_;
+  bool pipelined_;
+  // Whether Clear() has readied the connection for another request.
+  bool reused_;
   std::string content_type_;
   std::string request_path_;
   std::string request_headers_;
   std::string data_;
+  const char* error_status_;
+  // When the current request started, or when the connection went idle.
+  Clock::time_point request_started_;
+  Clock::time_point headers_received_at_;
+  static uint32_t s_socket_id_;
 };
 
 // The server socket.  Accepts connections and generates DataSocket instances
@@ -146,7 +252,9 @@ class ListeningSocket : public SocketBase {
   ListeningSocket() {}
 
   bool Listen(unsigned short port);
-  DataSocket* Accept() const;
+  // Accepts a pending connection.  The DataSocket is allocated from `pool`
+  // and must be returned to it.
+  DataSocket* Accept(ObjectPool<DataSocket>* pool) const;
 };
 
 #endif  // EXAMPLES_PEERCONNECTION_SERVER_DATA_SOCKET_H_
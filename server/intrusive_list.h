@@ -0,0 +1,151 @@
+/*
+ *  Copyright 2011 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_SERVER_INTRUSIVE_LIST_H_
+#define EXAMPLES_PEERCONNECTION_SERVER_INTRUSIVE_LIST_H_
+
+#include <stddef.h>
+
+#include "rtc_base/checks.h"
+
+template <typename T>
+class IntrusiveList;
+
+// Base class for objects that can be linked into an IntrusiveList.  An object
+// can be in at most one list at a time.
+template <typename T>
+class IntrusiveListNode {
+ public:
+  IntrusiveListNode() : prev_(nullptr), next_(nullptr), linked_(false) {}
+  IntrusiveListNode(const IntrusiveListNode&) = delete;
+  IntrusiveListNode& operator=(const IntrusiveListNode&) = delete;
+  ~IntrusiveListNode() { RTC_DCHECK(!linked_); }
+
+  bool linked() const { return linked_; }
+
+ private:
+  friend class IntrusiveList<T>;
+
+  T* prev_;
+  T* next_;
+  bool linked_;
+};
+
+// A doubly linked list of non-owned objects.  Insertion and removal are O(1)
+// and don't allocate.  Iterating yields T* so that code written against
+// std::vector<T*> reads the same.
+template <typename T>
+class IntrusiveList {
+ public:
+  class iterator {
+   public:
+    explicit iterator(T* item) : item_(item) {}
+
+    T* operator*() const { return item_; }
+    iterator& operator++() {
+      item_ = Node(item_)->next_;
+      return *this;
+    }
+    bool operator==(const iterator& other) const {
+      return item_ == other.item_;
+    }
+    bool operator!=(const iterator& other) const {
+      return item_ != other.item_;
+    }
+
+   private:
+    T* item_;
+  };
+  typedef iterator const_iterator;
+
+  IntrusiveList() : head_(nullptr), tail_(nullptr), size_(0) {}
+  IntrusiveList(const IntrusiveList&) = delete;
+  IntrusiveList& operator=(const IntrusiveList&) = delete;
+  ~IntrusiveList() { clear(); }
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  T* front() const { return head_; }
+
+  iterator begin() const { return iterator(head_); }
+  iterator end() const { return iterator(nullptr); }
+
+  static T* next(T* item) { return Node(item)->next_; }
+
+  void push_back(T* item) {
+    IntrusiveListNode<T>* node = Node(item);
+    RTC_DCHECK(!node->linked_);
+    node->prev_ = tail_;
+    node->next_ = nullptr;
+    node->linked_ = true;
+    if (tail_)
+      Node(tail_)->next_ = item;
+    else
+      head_ = item;
+    tail_ = item;
+    ++size_;
+  }
+
+  // Unlinks `item` and returns an iterator to the item that followed it.
+  iterator erase(iterator i) {
+    T* item = *i;
+    T* following = Node(item)->next_;
+    remove(item);
+    return iterator(following);
+  }
+
+  void remove(T* item) {
+    IntrusiveListNode<T>* node = Node(item);
+    RTC_DCHECK(node->linked_);
+    if (node->prev_)
+      Node(node->prev_)->next_ = node->next_;
+    else
+      head_ = node->next_;
+    if (node->next_)
+      Node(node->next_)->prev_ = node->prev_;
+    else
+      tail_ = node->prev_;
+    node->prev_ = node->next_ = nullptr;
+    node->linked_ = false;
+    --size_;
+  }
+
+  // Reorders the list so that it starts at `item` while keeping the cyclic
+  // order of the items, i.e. the items before `item` move to the back.
+  void rotate(T* item) {
+    RTC_DCHECK(Node(item)->linked_);
+    if (item == head_)
+      return;
+    IntrusiveListNode<T>* node = Node(item);
+    Node(tail_)->next_ = head_;
+    Node(head_)->prev_ = tail_;
+    tail_ = node->prev_;
+    Node(tail_)->next_ = nullptr;
+    node->prev_ = nullptr;
+    head_ = item;
+  }
+
+  // Unlinks all items.  The items themselves are not deleted.
+  void clear() {
+    while (head_)
+      remove(head_);
+  }
+
+ private:
+  static IntrusiveListNode<T>* Node(T* item) {
+    return static_cast<IntrusiveListNode<T>*>(item);
+  }
+
+  T* head_;
+  T* tail_;
+  size_t size_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_SERVER_INTRUSIVE_LIST_H_
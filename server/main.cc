@@ -15,14 +15,17 @@
 #endif
 #include <time.h>
 
+#include <algorithm>
+#include <chrono>
 #include <string>
-#include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/flags/usage.h"
-#include "examples/peerconnection/server/data_socket.h"
-#include "examples/peerconnection/server/peer_channel.h"
+#include "examples/headless_peerconnection/server/data_socket.h"
+#include "examples/headless_peerconnection/server/peer_channel.h"
+#include "examples/headless_peerconnection/server/request_trace.h"
+#include "examples/headless_peerconnection/server/utils.h"
 #include "rtc_base/checks.h"
 #include "system_wrappers/include/field_trial.h"
 #include "test/field_trial.h"
@@ -37,10 +40,132 @@ ABSL_FLAG(
     "will assign the group Enabled to field trial WebRTC-FooFeature. Multiple "
     "trials are separated by \"/\"");
 ABSL_FLAG(int, port, 8888, "default: 8888");
+ABSL_FLAG(int,
+          member_page_size,
+          0,
+          "Maximum number of member entries returned by a sign-in or "
+          "/members request.  Clients fetch the remaining entries with "
+          "/members and receive membership changes in batches.  0 returns "
+          "the whole list at sign-in.");
+ABSL_FLAG(double,
+          message_rate,
+          0,
+          "Sustained number of /message requests per second allowed for each "
+          "member.  0 disables the limit.");
+ABSL_FLAG(double,
+          message_burst,
+          20,
+          "Number of /message requests a member may send in a burst.");
+ABSL_FLAG(double,
+          sign_in_rate,
+          0,
+          "Sustained number of /sign_in requests per second allowed from each "
+          "remote address, shared by all clients on the same host.  0 "
+          "disables the limit.");
+ABSL_FLAG(double,
+          sign_in_burst,
+          200,
+          "Number of /sign_in requests an address may send in a burst.  A "
+          "load test signing in many clients from one host needs room for "
+          "all of them.");
+ABSL_FLAG(int,
+          work_budget,
+          64,
+          "Maximum number of socket reads served per pass of the server loop. "
+          "Sockets that don't fit are served first on the next pass.  0 "
+          "serves every readable socket on each pass.");
+ABSL_FLAG(std::string,
+          capture_file,
+          "",
+          "If set, every request the server handles is written to this file "
+          "for replay with headless_peerconnection_replay.");
+
+ABSL_FLAG(int,
+          max_header_size,
+          8 * 1024,
+          "Largest request header accepted, in bytes.  Larger requests are "
+          "answered with 413.  0 means unlimited.");
+ABSL_FLAG(int,
+          max_body_size,
+          256 * 1024,
+          "Largest request body accepted, in bytes.  Larger requests are "
+          "answered with 413.  0 means unlimited.");
+ABSL_FLAG(int,
+          header_timeout_ms,
+          10000,
+          "Time a connection has to deliver the headers of a request before "
+          "it's answered with 408 and closed.  0 disables the deadline.");
+ABSL_FLAG(int,
+          body_timeout_ms,
+          30000,
+          "Time a connection has to deliver the body of a request once the "
+          "headers are in before it's answered with 408 and closed.  0 "
+          "disables the deadline.");
+ABSL_FLAG(int,
+          idle_timeout_ms,
+          120000,
+          "Time a kept-alive connection may wait for its next request before "
+          "it's closed, without a response.  0 keeps idle connections open.");
 
 static const size_t kMaxConnections = (FD_SETSIZE - 2);
 
-void HandleBrowserRequest(DataSocket* ds, bool* quit) {
+// The longest the server waits in select() when no deadline is pending.
+static const std::chrono::seconds kMaxIdleWait(10);
+
+struct LoopStats {
+  size_t budget_exhausted = 0;
+  size_t requests_timed_out = 0;
+  size_t requests_rejected = 0;
+  size_t idle_connections_closed = 0;
+};
+
+std::string BuildStatsResponse(const PeerChannel& clients,
+                               const LoopStats& loop_stats) {
+  const ChannelStats& stats = clients.stats();
+  std::string response;
+  response += "members: " + size_t2str(clients.members().size()) + "\n";
+  response += "sign_ins: " + size_t2str(stats.sign_ins) + "\n";
+  response +=
+      "sign_ins_throttled: " + size_t2str(stats.sign_ins_throttled) + "\n";
+  response +=
+      "messages_forwarded: " + size_t2str(stats.messages_forwarded) + "\n";
+  response +=
+      "messages_throttled: " + size_t2str(stats.messages_throttled) + "\n";
+  response +=
+      "budget_exhausted: " + size_t2str(loop_stats.budget_exhausted) + "\n";
+  response +=
+      "requests_timed_out: " + size_t2str(loop_stats.requests_timed_out) +
+      "\n";
+  response +=
+      "requests_rejected: " + size_t2str(loop_stats.requests_rejected) + "\n";
+  response += "idle_connections_closed: " +
+              size_t2str(loop_stats.idle_connections_closed) + "\n";
+  return response;
+}
+
+// Microseconds since the epoch on the server's wall clock, the time base
+// that clients line their clocks up with.
+int64_t WallClockMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Answers "/time" with when the request was read and when the answer goes
+// out, "<received_us>,<sent_us>".  Clients take a series of these samples to
+// estimate the offset of their clock to ours, NTP style.
+void SendClockSample(DataSocket* ds, int64_t received_us) {
+  char body[64];
+  snprintf(body, sizeof(body), "%lld,%lld",
+           static_cast<long long>(received_us),
+           static_cast<long long>(WallClockMicros()));
+  ds->Send("200 OK", true, "text/plain", "", body);
+}
+
+void HandleBrowserRequest(DataSocket* ds,
+                          const PeerChannel& clients,
+                          const LoopStats& loop_stats,
+                          bool* quit) {
   RTC_DCHECK(ds && ds->valid());
   RTC_DCHECK(quit);
 
@@ -51,6 +176,9 @@ void HandleBrowserRequest(DataSocket* ds, bool* quit) {
   if (*quit) {
     ds->Send("200 OK", true, "text/html", "",
              "<html><body>Quitting...</body></html>");
+  } else if (ds->PathEquals("/stats")) {
+    ds->Send("200 OK", true, "text/plain", "",
+             BuildStatsResponse(clients, loop_stats));
   } else if (ds->method() == DataSocket::OPTIONS) {
     // We'll get this when a browsers do cross-resource-sharing requests.
     // The headers to allow cross-origin script support will be set inside
@@ -76,6 +204,20 @@ int main(int argc, char* argv[]) {
   webrtc::field_trial::InitFieldTrialsFromString(force_field_trials.c_str());
 
   int port = absl::GetFlag(FLAGS_port);
+  int member_page_size = absl::GetFlag(FLAGS_member_page_size);
+  int work_budget = absl::GetFlag(FLAGS_work_budget);
+
+  RateLimits limits;
+  limits.message_rate = absl::GetFlag(FLAGS_message_rate);
+  limits.message_burst = absl::GetFlag(FLAGS_message_burst);
+  limits.sign_in_rate = absl::GetFlag(FLAGS_sign_in_rate);
+  limits.sign_in_burst = absl::GetFlag(FLAGS_sign_in_burst);
+
+  int max_header_size = absl::GetFlag(FLAGS_max_header_size);
+  int max_body_size = absl::GetFlag(FLAGS_max_body_size);
+  int header_timeout_ms = absl::GetFlag(FLAGS_header_timeout_ms);
+  int body_timeout_ms = absl::GetFlag(FLAGS_body_timeout_ms);
+  int idle_timeout_ms = absl::GetFlag(FLAGS_idle_timeout_ms);
 
   // Abort if the user specifies a port that is outside the allowed
   // range [1, 65535].
@@ -84,6 +226,29 @@ int main(int argc, char* argv[]) {
     return -1;
   }
 
+  if (member_page_size < 0) {
+    printf("Error: %i is not a valid member page size.\n", member_page_size);
+    return -1;
+  }
+
+  if (work_budget < 0 || limits.message_rate < 0 || limits.sign_in_rate < 0) {
+    printf("Error: work budget and rate limits must not be negative.\n");
+    return -1;
+  }
+
+  if (max_header_size < 0 || max_body_size < 0 || header_timeout_ms < 0 ||
+      body_timeout_ms < 0 || idle_timeout_ms < 0) {
+    printf("Error: request size limits and timeouts must not be negative.\n");
+    return -1;
+  }
+
+  RequestLimits request_limits;
+  request_limits.max_header_size = max_header_size;
+  request_limits.max_body_size = max_body_size;
+  request_limits.header_timeout = std::chrono::milliseconds(header_timeout_ms);
+  request_limits.body_timeout = std::chrono::milliseconds(body_timeout_ms);
+  request_limits.idle_timeout = std::chrono::milliseconds(idle_timeout_ms);
+
   ListeningSocket listener;
   if (!listener.Create()) {
     printf("Failed to create server socket\n");
@@ -93,11 +258,25 @@ int main(int argc, char* argv[]) {
     return -1;
   }
 
+  RequestTraceWriter trace;
+  const std::string capture_file = absl::GetFlag(FLAGS_capture_file);
+  if (!capture_file.empty()) {
+    if (!trace.Open(capture_file)) {
+      printf("Failed to open capture file %s\n", capture_file.c_str());
+      return -1;
+    }
+    printf("Capturing requests to %s\n", capture_file.c_str());
+  }
+
   printf("Server listening on port %i\n", port);
 
   PeerChannel clients;
-  typedef std::vector<DataSocket*> SocketArray;
-  SocketArray sockets;
+  clients.set_member_page_size(member_page_size);
+  clients.set_rate_limits(limits);
+  LoopStats loop_stats;
+  ObjectPool<DataSocket> socket_pool;
+  typedef IntrusiveList<DataSocket> SocketList;
+  SocketList sockets;
   bool quit = false;
   while (!quit) {
     fd_set socket_set;
@@ -105,25 +284,63 @@ int main(int argc, char* argv[]) {
     if (listener.valid())
       FD_SET(listener.socket(), &socket_set);
 
-    for (SocketArray::iterator i = sockets.begin(); i != sockets.end(); ++i)
+    // Wake up in time for the earliest request deadline.
+    DataSocket::Clock::time_point now = DataSocket::Clock::now();
+    DataSocket::Clock::time_point wake_up = now + kMaxIdleWait;
+    for (SocketList::iterator i = sockets.begin(); i != sockets.end(); ++i) {
       FD_SET((*i)->socket(), &socket_set);
+      wake_up = std::min(wake_up, (*i)->deadline(request_limits));
+    }
 
-    struct timeval timeout = {10, 0};
-    if (select(FD_SETSIZE, &socket_set, NULL, NULL, &timeout) == SOCKET_ERROR) {
+    DataSocket::Clock::duration wait =
+        std::max(wake_up - now, DataSocket::Clock::duration());
+    int64_t wait_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(wait).count();
+    struct timeval timeout = {static_cast<long>(wait_us / 1000000),
+                              static_cast<long>(wait_us % 1000000)};
+    int ready = select(FD_SETSIZE, &socket_set, NULL, NULL, &timeout);
+    if (ready == SOCKET_ERROR) {
       printf("select failed\n");
       break;
     }
 
-    for (SocketArray::iterator i = sockets.begin(); i != sockets.end(); ++i) {
+    // Write captured requests out while there's nothing else to do.
+    if (ready == 0)
+      trace.Flush();
+
+    // Readable sockets beyond the work budget are left for the next pass, and
+    // the pass after that starts with them so that every socket gets its turn.
+    int work_done = 0;
+    DataSocket* resume_at = NULL;
+    SocketList::iterator i = sockets.begin();
+    while (i != sockets.end()) {
       DataSocket* s = *i;
+      ++i;
       bool socket_done = true;
-      if (FD_ISSET(s->socket(), &socket_set)) {
-        if (s->OnDataAvailable(&socket_done) && s->request_received()) {
+      if (FD_ISSET(s->socket(), &socket_set) && work_budget &&
+          work_done == work_budget) {
+        if (!resume_at)
+          resume_at = s;
+        socket_done = false;
+      } else if (FD_ISSET(s->socket(), &socket_set)) {
+        ++work_done;
+        int64_t read_us = WallClockMicros();
+        bool data_ok = s->OnDataAvailable(request_limits, &socket_done);
+        if (!data_ok && s->error_status()) {
+          printf("Rejecting request: %s\n", s->error_status());
+          ++loop_stats.requests_rejected;
+          s->Send(s->error_status(), true, "text/plain", "", "");
+          socket_done = true;
+        } else if (data_ok && s->request_received()) {
+          bool parked = false;
+          int32_t signed_in_id = -1;
           ChannelMember* member = clients.Lookup(s);
           if (member || PeerChannel::IsPeerConnection(s)) {
             if (!member) {
               if (s->PathEquals("/sign_in")) {
-                clients.AddMember(s);
+                ChannelMember* new_member = clients.AddMember(s);
+                if (new_member)
+                  signed_in_id = new_member->id();
               } else {
                 printf("No member found for: %s\n", s->request_path().c_str());
                 s->Send("500 Error", true, "text/plain", "",
@@ -132,12 +349,17 @@ int main(int argc, char* argv[]) {
             } else if (member->is_wait_request(s)) {
               // no need to do anything.
               socket_done = false;
+              parked = true;
             } else {
               ChannelMember* target = clients.IsTargetedRequest(s);
               if (target) {
-                member->ForwardRequestToPeer(s, target);
+                clients.ForwardRequest(member, s, target);
               } else if (s->PathEquals("/sign_out")) {
                 s->Send("200 OK", true, "text/plain", "", "");
+              } else if (s->PathEquals("/members")) {
+                clients.SendMemberPage(*member, s);
+              } else if (s->PathEquals("/time")) {
+                SendClockSample(s, read_us);
               } else {
                 printf("Couldn't find target for request: %s\n",
                        s->request_path().c_str());
@@ -146,7 +368,7 @@ int main(int argc, char* argv[]) {
               }
             }
           } else {
-            HandleBrowserRequest(s, &quit);
+            HandleBrowserRequest(s, clients, loop_stats, &quit);
             if (quit) {
               printf("Quitting...\n");
               FD_CLR(listener.socket(), &socket_set);
@@ -154,6 +376,20 @@ int main(int argc, char* argv[]) {
               clients.CloseAll();
             }
           }
+          trace.Write(s->id(), signed_in_id, s->method(), s->request_path(),
+                      s->data());
+
+          // A keep-alive connection has been answered and goes back to
+          // waiting for the next request.  As far as the channel is
+          // concerned the request is over, as if the socket had closed.
+          if (s->keep_alive() && !parked && !quit) {
+            clients.OnClosing(s);
+            s->Clear();
+          } else if (s->pipelined() && !parked) {
+            // The requests behind this one were dropped.  Ending the
+            // connection tells the client to send them again on a new one.
+            s->Shutdown();
+          }
         }
       } else {
         socket_done = false;
@@ -164,19 +400,50 @@ int main(int argc, char* argv[]) {
         clients.OnClosing(s);
         RTC_DCHECK(s->valid());  // Close must not have been called yet.
         FD_CLR(s->socket(), &socket_set);
-        delete (*i);
-        i = sockets.erase(i);
-        if (i == sockets.end())
-          break;
+        sockets.remove(s);
+        socket_pool.Delete(s);
       }
     }
 
+    if (resume_at) {
+      ++loop_stats.budget_exhausted;
+      sockets.rotate(resume_at);
+    }
+
+    // Evict connections that are too slow to deliver their request so that
+    // they can't hold on to a connection slot.
+    now = DataSocket::Clock::now();
+    i = sockets.begin();
+    while (i != sockets.end()) {
+      DataSocket* s = *i;
+      ++i;
+      if (s->deadline(request_limits) > now)
+        continue;
+      if (s->idle()) {
+        // A request that arrived after the read pass is read on the next one
+        // rather than lost with the connection.
+        if (FD_ISSET(s->socket(), &socket_set))
+          continue;
+        printf("Closing idle connection\n");
+        ++loop_stats.idle_connections_closed;
+      } else {
+        printf("Request timed out\n");
+        ++loop_stats.requests_timed_out;
+        s->Send("408 Request Timeout", true, "text/plain", "", "");
+      }
+      clients.OnClosing(s);
+      sockets.remove(s);
+      socket_pool.Delete(s);
+    }
+
     clients.CheckForTimeout();
 
     if (FD_ISSET(listener.socket(), &socket_set)) {
-      DataSocket* s = listener.Accept();
-      if (sockets.size() >= kMaxConnections) {
-        delete s;  // sorry, that's all we can take.
+      DataSocket* s = listener.Accept(&socket_pool);
+      if (!s) {
+        printf("Failed to accept connection\n");
+      } else if (sockets.size() >= kMaxConnections) {
+        socket_pool.Delete(s);  // sorry, that's all we can take.
         printf("Connection limit reached\n");
       } else {
         sockets.push_back(s);
@@ -185,9 +452,11 @@ int main(int argc, char* argv[]) {
     }
   }
 
-  for (SocketArray::iterator i = sockets.begin(); i != sockets.end(); ++i)
-    delete (*i);
-  sockets.clear();
+  while (!sockets.empty()) {
+    DataSocket* s = sockets.front();
+    sockets.remove(s);
+    socket_pool.Delete(s);
+  }
 
   return 0;
 }
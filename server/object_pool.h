@@ -0,0 +1,80 @@
+/*
+ *  Copyright 2011 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_SERVER_OBJECT_POOL_H_
+#define EXAMPLES_PEERCONNECTION_SERVER_OBJECT_POOL_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "rtc_base/checks.h"
+
+// Allocates objects of type T from slabs of `kSlabSize` fixed-size slots.
+// Freed slots go on a free list and are handed out again before a new slab
+// is allocated, so steady-state churn doesn't touch the heap.  Slabs are
+// only released when the pool is destroyed, at which point every object
+// must have been deleted.
+template <typename T, size_t kSlabSize = 64>
+class ObjectPool {
+ public:
+  ObjectPool() : free_(nullptr), live_(0) {}
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+  ~ObjectPool() { RTC_DCHECK_EQ(live_, 0); }
+
+  size_t live() const { return live_; }
+  size_t capacity() const { return slabs_.size() * kSlabSize; }
+
+  template <typename... Args>
+  T* New(Args&&... args) {
+    if (!free_)
+      Grow();
+    Slot* slot = free_;
+    free_ = slot->next;
+    ++live_;
+    return new (slot->storage) T(std::forward<Args>(args)...);
+  }
+
+  void Delete(T* object) {
+    if (!object)
+      return;
+    object->~T();
+    Slot* slot = reinterpret_cast<Slot*>(object);
+    slot->next = free_;
+    free_ = slot;
+    RTC_DCHECK_GT(live_, 0);
+    --live_;
+  }
+
+ private:
+  union Slot {
+    Slot* next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  void Grow() {
+    std::unique_ptr<Slot[]> slab(new Slot[kSlabSize]);
+    for (size_t i = 0; i < kSlabSize; ++i) {
+      slab[i].next = free_;
+      free_ = &slab[i];
+    }
+    slabs_.push_back(std::move(slab));
+  }
+
+  std::vector<std::unique_ptr<Slot[]>> slabs_;
+  Slot* free_;
+  size_t live_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_SERVER_OBJECT_POOL_H_
@@ -8,15 +8,15 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 
-#include "examples/peerconnection/server/peer_channel.h"
+#include "examples/headless_peerconnection/server/peer_channel.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 
 #include <algorithm>
 
-#include "examples/peerconnection/server/data_socket.h"
-#include "examples/peerconnection/server/utils.h"
+#include "examples/headless_peerconnection/server/data_socket.h"
+#include "examples/headless_peerconnection/server/utils.h"
 #include "rtc_base/checks.h"
 
 // Set to the peer id of the originator when messages are being
@@ -32,30 +32,70 @@
 // at this point it is not working correctly in some popular browsers.
 static const char kPeerIdHeader[] = "Pragma: ";
 
+// Carries the member list version a sign-in, "/members" or membership
+// notification response brings the receiver up to.  Clients that page
+// through the list use it to tell which notifications are already covered.
+static const char kMemberVersionHeader[] = "X-Member-Version: ";
+
+// Present on sign-in and "/members" responses when the member list did not
+// fit in one page.  The value is the "after" argument for the next page.
+static const char kMemberNextHeader[] = "X-Member-Next: ";
+
+// A "/wait" request with this argument is answered with a chunked response
+// that stays open.  Each chunk carries one notification, framed exactly like
+// the response to a plain "/wait" request would be.  Servers that don't know
+// the argument answer a single notification, so clients fall back to making
+// a new request for each one.
+static const char kStreamArgument[] = "stream=1";
+
 static const char* kRequestPaths[] = {
     "/wait",
     "/sign_out",
     "/message",
+    "/members",
+    "/time",
 };
 
 enum RequestPathIndex {
   kWait,
   kSignOut,
   kMessage,
+  kMembers,
+  kTime,
 };
 
 const size_t kMaxNameLength = 512;
 
+// Returns the value of the "peer_id" argument of the request, or -1 if there
+// is none.
+static int GetPeerIdArgument(const DataSocket* ds) {
+  std::string args(ds->request_arguments());
+  static const char kPeerId[] = "peer_id=";
+  size_t found = args.find(kPeerId);
+  if (found == std::string::npos)
+    return -1;
+  return atoi(&args[found + ARRAYSIZE(kPeerId) - 1]);
+}
+
+static bool IsStreamRequest(const DataSocket* ds) {
+  if (!ds)
+    return false;
+  std::string args(ds->request_arguments());
+  size_t found = args.find(kStreamArgument);
+  return found != std::string::npos && (found == 0 || args[found - 1] == '&');
+}
+
 //
 // ChannelMember
 //
 
 int ChannelMember::s_member_id_ = 0;
 
-ChannelMember::ChannelMember(DataSocket* socket)
+ChannelMember::ChannelMember(DataSocket* socket, bool batch_updates)
     : waiting_socket_(NULL),
       id_(++s_member_id_),
       connected_(true),
+      batch_updates_(batch_updates),
       timestamp_(time(NULL)) {
   RTC_DCHECK(socket);
   RTC_DCHECK_EQ(socket->method(), DataSocket::GET);
@@ -67,10 +107,16 @@ ChannelMember::ChannelMember(DataSocket* socket)
     name_.resize(kMaxNameLength);
 
   std::replace(name_.begin(), name_.end(), ',', '_');
+  UpdateEntry();
 }
 
 ChannelMember::~ChannelMember() {}
 
+void ChannelMember::set_disconnected() {
+  connected_ = false;
+  UpdateEntry();
+}
+
 bool ChannelMember::is_wait_request(DataSocket* ds) const {
   return ds && ds->PathEquals(kRequestPaths[kWait]);
 }
@@ -84,21 +130,40 @@ std::string ChannelMember::GetPeerIdHeader() const {
   return ret;
 }
 
-bool ChannelMember::NotifyOfOtherMember(const ChannelMember& other) {
+bool ChannelMember::NotifyOfOtherMember(const ChannelMember& other,
+                                        int version) {
   RTC_DCHECK_NE(&other, this);
-  QueueResponse("200 OK", "text/plain", GetPeerIdHeader(), other.GetEntry());
+  std::string extra_headers(GetPeerIdHeader());
+  extra_headers += kMemberVersionHeader + int2str(version) + "\r\n";
+
+  if (batch_updates_ && !waiting_socket_ && !queue_.empty() &&
+      queue_.back().member_version != 0) {
+    // Fold the change into the notification that is already waiting for the
+    // peer's next hanging GET.
+    QueuedResponse& pending = queue_.back();
+    pending.extra_headers = extra_headers;
+    pending.data += other.GetEntry();
+    pending.member_version = version;
+    return true;
+  }
+
+  bool queued = waiting_socket_ == NULL;
+  QueueResponse("200 OK", "text/plain", extra_headers, other.GetEntry());
+  if (queued)
+    queue_.back().member_version = version;
   return true;
 }
 
-// Returns a string in the form "name,id,connected\n".
-std::string ChannelMember::GetEntry() const {
+// Caches the "name,id,connected\n" entry so that building member lists
+// doesn't format every entry over again.
+void ChannelMember::UpdateEntry() {
   RTC_DCHECK(name_.length() <= kMaxNameLength);
 
   // name, 11-digit int, 1-digit bool, newline, null
   char entry[kMaxNameLength + 15];
-  snprintf(entry, sizeof(entry), "%s,%d,%d\n",
-           name_.substr(0, kMaxNameLength).c_str(), id_, connected_);
-  return entry;
+  snprintf(entry, sizeof(entry), "%s,%d,%d\n", name_.c_str(), id_,
+           connected_);
+  entry_ = entry;
 }
 
 void ChannelMember::ForwardRequestToPeer(DataSocket* ds, ChannelMember* peer) {
@@ -128,7 +193,15 @@ void ChannelMember::QueueResponse(const std::string& status,
                                   const std::string& content_type,
                                   const std::string& extra_headers,
                                   const std::string& data) {
-  if (waiting_socket_) {
+  if (waiting_socket_ && waiting_socket_->streaming()) {
+    RTC_DCHECK(queue_.empty());
+    if (!waiting_socket_->SendChunk(status, content_type, extra_headers,
+                                    data)) {
+      printf("Failed to deliver data to streaming socket\n");
+      waiting_socket_ = NULL;
+      timestamp_ = time(NULL);
+    }
+  } else if (waiting_socket_) {
     RTC_DCHECK(queue_.empty());
     RTC_DCHECK_EQ(waiting_socket_->method(), DataSocket::GET);
     bool ok =
@@ -149,8 +222,32 @@ void ChannelMember::QueueResponse(const std::string& status,
 }
 
 void ChannelMember::SetWaitingSocket(DataSocket* ds) {
-  RTC_DCHECK_EQ(ds->method(), DataSocket::GET);
-  if (ds && !queue_.empty()) {
+  RTC_DCHECK(!ds || ds->method() == DataSocket::GET);
+  if (IsStreamRequest(ds)) {
+    // A client opens a new stream when it believes the old one is gone.  Shut
+    // the old one down so that the server loop sees it close and frees it.
+    if (waiting_socket_ && waiting_socket_ != ds) {
+      printf("Replacing the stream of %s\n", name_.c_str());
+      waiting_socket_->Shutdown();
+    }
+    // The socket stays the waiting socket until it closes, taking the queued
+    // notifications now and every later one as it happens.
+    ds->StartChunkedResponse("200 OK", "application/http", GetPeerIdHeader());
+    waiting_socket_ = ds;
+    std::queue<QueuedResponse> backlog;
+    backlog.swap(queue_);
+    while (!backlog.empty() && waiting_socket_) {
+      const QueuedResponse& response = backlog.front();
+      QueueResponse(response.status, response.content_type,
+                    response.extra_headers, response.data);
+      backlog.pop();
+    }
+    // Whatever the stream failed to take waits for the next request.
+    while (!backlog.empty()) {
+      queue_.push(backlog.front());
+      backlog.pop();
+    }
+  } else if (ds && !queue_.empty()) {
     RTC_DCHECK(!waiting_socket_);
     const QueuedResponse& response = queue_.front();
     ds->Send(response.status, true, response.content_type,
@@ -187,25 +284,15 @@ ChannelMember* PeerChannel::Lookup(DataSocket* ds) const {
   if (i == ARRAYSIZE(kRequestPaths))
     return NULL;
 
-  std::string args(ds->request_arguments());
-  static const char kPeerId[] = "peer_id=";
-  size_t found = args.find(kPeerId);
-  if (found == std::string::npos)
-    return NULL;
-
-  int id = atoi(&args[found + ARRAYSIZE(kPeerId) - 1]);
-  Members::const_iterator iter = members_.begin();
-  for (; iter != members_.end(); ++iter) {
-    if (id == (*iter)->id()) {
-      if (i == kWait)
-        (*iter)->SetWaitingSocket(ds);
-      if (i == kSignOut)
-        (*iter)->set_disconnected();
-      return *iter;
-    }
+  ChannelMember* member = FindMember(GetPeerIdArgument(ds));
+  if (member) {
+    if (i == kWait)
+      member->SetWaitingSocket(ds);
+    if (i == kSignOut)
+      member->set_disconnected();
   }
 
-  return NULL;
+  return member;
 }
 
 ChannelMember* PeerChannel::IsTargetedRequest(const DataSocket* ds) const {
@@ -228,32 +315,69 @@ ChannelMember* PeerChannel::IsTargetedRequest(const DataSocket* ds) const {
     }
     args = found + ARRAYSIZE(kTargetPeerIdParam) - 1;
   } while (true);
-  int id = atoi(&path[found]);
-  Members::const_iterator i = members_.begin();
-  for (; i != members_.end(); ++i) {
-    if ((*i)->id() == id) {
-      return *i;
-    }
-  }
-  return NULL;
+  return FindMember(atoi(&path[found]));
 }
 
-bool PeerChannel::AddMember(DataSocket* ds) {
+ChannelMember* PeerChannel::AddMember(DataSocket* ds) {
   RTC_DCHECK(IsPeerConnection(ds));
-  ChannelMember* new_guy = new ChannelMember(ds);
+
+  if (limits_.sign_in_rate > 0) {
+    std::map<uint32_t, TokenBucket>::iterator bucket =
+        sign_in_buckets_.find(ds->remote_address());
+    if (bucket == sign_in_buckets_.end()) {
+      bucket = sign_in_buckets_
+                   .insert(std::make_pair(
+                       ds->remote_address(),
+                       TokenBucket(limits_.sign_in_rate,
+                                   limits_.sign_in_burst)))
+                   .first;
+    }
+    if (!bucket->second.TryConsume()) {
+      ++stats_.sign_ins_throttled;
+      ds->Send("429 Too Many Requests", true, "text/plain", "",
+               "Too many sign-in attempts.");
+      return NULL;
+    }
+  }
+
+  ++stats_.sign_ins;
+  ChannelMember* new_guy = member_pool_.New(ds, member_page_size_ != 0);
+  new_guy->set_message_limit(limits_.message_rate, limits_.message_burst);
   Members failures;
   BroadcastChangedState(*new_guy, &failures);
   HandleDeliveryFailures(&failures);
   members_.push_back(new_guy);
+  members_by_id_[new_guy->id()] = new_guy;
 
   printf("New member added (total=%s): %s\n",
          size_t2str(members_.size()).c_str(), new_guy->name().c_str());
 
   // Let the newly connected peer know about other members of the channel.
   std::string content_type;
-  std::string response = BuildResponseForNewMember(*new_guy, &content_type);
-  ds->Send("200 Added", true, content_type, new_guy->GetPeerIdHeader(),
-           response);
+  std::string extra_headers;
+  std::string response =
+      BuildResponseForNewMember(*new_guy, &content_type, &extra_headers);
+  ds->Send("200 Added", true, content_type, extra_headers, response);
+  return new_guy;
+}
+
+bool PeerChannel::ForwardRequest(ChannelMember* member,
+                                 DataSocket* ds,
+                                 ChannelMember* target) {
+  RTC_DCHECK(member);
+  RTC_DCHECK(ds);
+  RTC_DCHECK(target);
+
+  if (!member->AllowMessage()) {
+    ++stats_.messages_throttled;
+    printf("Throttling messages from %s\n", member->name().c_str());
+    ds->Send("429 Too Many Requests", true, "text/plain", "",
+             "Too many messages.");
+    return false;
+  }
+
+  ++stats_.messages_forwarded;
+  member->ForwardRequestToPeer(ds, target);
   return true;
 }
 
@@ -266,43 +390,81 @@ void PeerChannel::CloseAll() {
 }
 
 void PeerChannel::OnClosing(DataSocket* ds) {
-  for (Members::iterator i = members_.begin(); i != members_.end(); ++i) {
-    ChannelMember* m = (*i);
+  // Only the member that made the request can be affected: either `ds` was
+  // its hanging GET, or the member signed out over `ds`.
+  ChannelMember* m = FindMember(GetPeerIdArgument(ds));
+  if (m) {
     m->OnClosing(ds);
     if (!m->connected()) {
-      i = members_.erase(i);
-      Members failures;
-      BroadcastChangedState(*m, &failures);
-      HandleDeliveryFailures(&failures);
-      delete m;
-      if (i == members_.end())
-        break;
+      RemoveMember(m);
+      Members gone;
+      gone.push_back(m);
+      HandleDeliveryFailures(&gone);
     }
   }
   printf("Total connected: %s\n", size_t2str(members_.size()).c_str());
 }
 
 void PeerChannel::CheckForTimeout() {
-  for (Members::iterator i = members_.begin(); i != members_.end(); ++i) {
+  Members timed_out;
+  Members::iterator i = members_.begin();
+  while (i != members_.end()) {
     ChannelMember* m = (*i);
+    ++i;
     if (m->TimedOut()) {
       printf("Timeout: %s\n", m->name().c_str());
       m->set_disconnected();
-      i = members_.erase(i);
-      Members failures;
-      BroadcastChangedState(*m, &failures);
-      HandleDeliveryFailures(&failures);
-      delete m;
-      if (i == members_.end())
-        break;
+      RemoveMember(m);
+      timed_out.push_back(m);
     }
   }
+  HandleDeliveryFailures(&timed_out);
+
+  std::map<uint32_t, TokenBucket>::iterator bucket = sign_in_buckets_.begin();
+  while (bucket != sign_in_buckets_.end()) {
+    if (bucket->second.IsFull()) {
+      bucket = sign_in_buckets_.erase(bucket);
+    } else {
+      ++bucket;
+    }
+  }
+}
+
+void PeerChannel::SendMemberPage(const ChannelMember& member,
+                                 DataSocket* ds) const {
+  RTC_DCHECK(ds);
+  RTC_DCHECK(ds->PathEquals(kRequestPaths[kMembers]));
+
+  std::string args(ds->request_arguments());
+  static const char kAfter[] = "after=";
+  int after = 0;
+  size_t found = args.find(kAfter);
+  if (found != std::string::npos)
+    after = atoi(&args[found + ARRAYSIZE(kAfter) - 1]);
+
+  std::string response;
+  std::string extra_headers(member.GetPeerIdHeader());
+  extra_headers += AppendMemberPage(member, after, &response);
+  ds->Send("200 OK", true, "text/plain", extra_headers, response);
+}
+
+ChannelMember* PeerChannel::FindMember(int id) const {
+  std::unordered_map<int, ChannelMember*>::const_iterator found =
+      members_by_id_.find(id);
+  return found == members_by_id_.end() ? NULL : found->second;
+}
+
+void PeerChannel::RemoveMember(ChannelMember* member) {
+  members_.remove(member);
+  members_by_id_.erase(member->id());
 }
 
 void PeerChannel::DeleteAll() {
-  for (Members::iterator i = members_.begin(); i != members_.end(); ++i)
-    delete (*i);
-  members_.clear();
+  while (!members_.empty()) {
+    ChannelMember* m = members_.front();
+    RemoveMember(m);
+    member_pool_.Delete(m);
+  }
 }
 
 void PeerChannel::BroadcastChangedState(const ChannelMember& member,
@@ -314,16 +476,16 @@ void PeerChannel::BroadcastChangedState(const ChannelMember& member,
     printf("Member disconnected: %s\n", member.name().c_str());
   }
 
+  ++version_;
+
   Members::iterator i = members_.begin();
-  for (; i != members_.end(); ++i) {
-    if (&member != (*i)) {
-      if (!(*i)->NotifyOfOtherMember(member)) {
-        (*i)->set_disconnected();
-        delivery_failures->push_back(*i);
-        i = members_.erase(i);
-        if (i == members_.end())
-          break;
-      }
+  while (i != members_.end()) {
+    ChannelMember* m = (*i);
+    ++i;
+    if (&member != m && !m->NotifyOfOtherMember(member, version_)) {
+      m->set_disconnected();
+      RemoveMember(m);
+      delivery_failures->push_back(m);
     }
   }
 }
@@ -332,29 +494,65 @@ void PeerChannel::HandleDeliveryFailures(Members* failures) {
   RTC_DCHECK(failures);
 
   while (!failures->empty()) {
-    Members::iterator i = failures->begin();
-    ChannelMember* member = *i;
+    ChannelMember* member = failures->front();
     RTC_DCHECK(!member->connected());
-    failures->erase(i);
+    failures->remove(member);
     BroadcastChangedState(*member, failures);
-    delete member;
+    member_pool_.Delete(member);
   }
 }
 
 // Builds a simple list of "name,id\n" entries for each member.
 std::string PeerChannel::BuildResponseForNewMember(const ChannelMember& member,
-                                                   std::string* content_type) {
+                                                   std::string* content_type,
+                                                   std::string* extra_headers) {
   RTC_DCHECK(content_type);
+  RTC_DCHECK(extra_headers);
 
   *content_type = "text/plain";
   // The peer itself will always be the first entry.
   std::string response(member.GetEntry());
-  for (Members::iterator i = members_.begin(); i != members_.end(); ++i) {
-    if (member.id() != (*i)->id()) {
-      RTC_DCHECK((*i)->connected());
-      response += (*i)->GetEntry();
+  *extra_headers = member.GetPeerIdHeader();
+  *extra_headers += AppendMemberPage(member, 0, &response);
+
+  return response;
+}
+
+std::string PeerChannel::AppendMemberPage(const ChannelMember& member,
+                                          int after,
+                                          std::string* response) const {
+  RTC_DCHECK(response);
+
+  // Member ids are handed out in increasing order and new members are
+  // appended, so `members_` is sorted by id.  Resume right after the cursor
+  // if that member is still around, otherwise skip ahead to it.
+  ChannelMember* start = members_.front();
+  if (after > 0) {
+    ChannelMember* cursor = FindMember(after);
+    if (cursor) {
+      start = Members::next(cursor);
+    } else {
+      while (start && start->id() <= after)
+        start = Members::next(start);
     }
   }
+  Members::const_iterator i(start);
 
-  return response;
+  size_t count = 0;
+  int last_id = after;
+  for (; i != members_.end(); ++i) {
+    if (member.id() == (*i)->id())
+      continue;
+    if (member_page_size_ && count == member_page_size_)
+      break;
+    RTC_DCHECK((*i)->connected());
+    *response += (*i)->GetEntry();
+    last_id = (*i)->id();
+    ++count;
+  }
+
+  std::string headers(kMemberVersionHeader + int2str(version_) + "\r\n");
+  if (i != members_.end())
+    headers += kMemberNextHeader + int2str(last_id) + "\r\n";
+  return headers;
 }
@@ -11,34 +11,73 @@
 #ifndef EXAMPLES_PEERCONNECTION_SERVER_PEER_CHANNEL_H_
 #define EXAMPLES_PEERCONNECTION_SERVER_PEER_CHANNEL_H_
 
+#include <stdint.h>
 #include <time.h>
 
+#include <map>
 #include <queue>
 #include <string>
-#include <vector>
+#include <unordered_map>
+
+#include "examples/headless_peerconnection/server/intrusive_list.h"
+#include "examples/headless_peerconnection/server/object_pool.h"
+#include "examples/headless_peerconnection/server/token_bucket.h"
 
 class DataSocket;
 
+// Request rate limits, in requests per second.  A rate of zero disables the
+// corresponding limit.
+struct RateLimits {
+  // Applies to the /message requests of each member.
+  double message_rate = 0;
+  double message_burst = 0;
+  // Applies to /sign_in requests coming from the same address, so all the
+  // clients a load test runs on one host share it.  A sign-in is the first
+  // request on its connection, which is why it can't be keyed any finer.
+  double sign_in_rate = 0;
+  double sign_in_burst = 0;
+};
+
+// Counters exposed on the server's /stats page.
+struct ChannelStats {
+  size_t sign_ins = 0;
+  size_t sign_ins_throttled = 0;
+  size_t messages_forwarded = 0;
+  size_t messages_throttled = 0;
+};
+
 // Represents a single peer connected to the server.
-class ChannelMember {
+class ChannelMember : public IntrusiveListNode<ChannelMember> {
  public:
-  explicit ChannelMember(DataSocket* socket);
+  // If `batch_updates` is set, membership notifications that pile up while
+  // the peer has no hanging GET outstanding are delivered as a single
+  // multi-line response instead of one response per change.
+  ChannelMember(DataSocket* socket, bool batch_updates);
   ~ChannelMember();
 
   bool connected() const { return connected_; }
   int id() const { return id_; }
-  void set_disconnected() { connected_ = false; }
+  void set_disconnected();
   bool is_wait_request(DataSocket* ds) const;
   const std::string& name() const { return name_; }
 
+  void set_message_limit(double rate, double burst) {
+    message_bucket_ = TokenBucket(rate, burst);
+  }
+
+  // Returns false if the member has used up its share of /message requests.
+  bool AllowMessage() { return message_bucket_.TryConsume(); }
+
   bool TimedOut();
 
   std::string GetPeerIdHeader() const;
 
-  bool NotifyOfOtherMember(const ChannelMember& other);
+  // Queues a notification about `other` having joined or left.  `version` is
+  // the channel's member list version after the change.
+  bool NotifyOfOtherMember(const ChannelMember& other, int version);
 
-  // Returns a string in the form "name,id\n".
-  std::string GetEntry() const;
+  // Returns a string in the form "name,id,connected\n".
+  const std::string& GetEntry() const { return entry_; }
 
   void ForwardRequestToPeer(DataSocket* ds, ChannelMember* peer);
 
@@ -54,13 +93,21 @@ class ChannelMember {
  protected:
   struct QueuedResponse {
     std::string status, content_type, extra_headers, data;
+    // Non-zero for membership notifications; the member list version the
+    // notification brings the peer up to.
+    int member_version = 0;
   };
 
+  void UpdateEntry();
+
   DataSocket* waiting_socket_;
   int id_;
   bool connected_;
+  bool batch_updates_;
   time_t timestamp_;
   std::string name_;
+  std::string entry_;
+  TokenBucket message_bucket_;
   std::queue<QueuedResponse> queue_;
   static int s_member_id_;
 };
@@ -68,14 +115,26 @@ class ChannelMember {
 // Manages all currently connected peers.
 class PeerChannel {
  public:
-  typedef std::vector<ChannelMember*> Members;
+  typedef IntrusiveList<ChannelMember> Members;
 
-  PeerChannel() {}
+  PeerChannel() : member_page_size_(0), version_(0) {}
 
   ~PeerChannel() { DeleteAll(); }
 
   const Members& members() const { return members_; }
 
+  // Limits the number of entries returned by a sign-in or "/members" request.
+  // Zero (the default) returns the whole list in the sign-in response, which
+  // is what legacy clients expect.
+  void set_member_page_size(size_t size) { member_page_size_ = size; }
+
+  // Incremented every time a member joins or leaves the channel.
+  int version() const { return version_; }
+
+  void set_rate_limits(const RateLimits& limits) { limits_ = limits; }
+
+  const ChannelStats& stats() const { return stats_; }
+
   // Returns true if the request should be treated as a new ChannelMember
   // request.  Otherwise the request is not peerconnection related.
   static bool IsPeerConnection(const DataSocket* ds);
@@ -88,8 +147,15 @@ class PeerChannel {
   ChannelMember* IsTargetedRequest(const DataSocket* ds) const;
 
   // Adds a new ChannelMember instance to the list of connected peers and
-  // associates it with the socket.
-  bool AddMember(DataSocket* ds);
+  // associates it with the socket.  Responds with "429 Too Many Requests"
+  // and returns NULL if the socket's address signs in too often.
+  ChannelMember* AddMember(DataSocket* ds);
+
+  // Forwards a /message request from `member` to `target`, or rejects it with
+  // "429 Too Many Requests" if `member` exceeds its message rate.
+  bool ForwardRequest(ChannelMember* member,
+                      DataSocket* ds,
+                      ChannelMember* target);
 
   // Closes all connections and sends a "shutting down" message to all
   // connected peers.
@@ -101,7 +167,18 @@ class PeerChannel {
 
   void CheckForTimeout();
 
+  // Responds to a "/members?peer_id=<id>&after=<id>" request with the next
+  // page of the member list, in the same format as the sign-in response.
+  void SendMemberPage(const ChannelMember& member, DataSocket* ds) const;
+
  protected:
+  // Returns the member with the given id, or NULL.
+  ChannelMember* FindMember(int id) const;
+
+  // Unlinks `member` from `members_` and the id index.  The caller is
+  // responsible for handing it back to `member_pool_`.
+  void RemoveMember(ChannelMember* member);
+
   void DeleteAll();
   void BroadcastChangedState(const ChannelMember& member,
                              Members* delivery_failures);
@@ -109,10 +186,29 @@ class PeerChannel {
 
   // Builds a simple list of "name,id\n" entries for each member.
   std::string BuildResponseForNewMember(const ChannelMember& member,
-                                        std::string* content_type);
+                                        std::string* content_type,
+                                        std::string* extra_headers);
+
+  // Appends entries for up to `member_page_size_` members (all of them if
+  // paging is disabled) whose id is greater than `after`, skipping `member`.
+  // Returns the headers describing the page: the list version and, if there
+  // are more entries to fetch, the cursor to pass as "after" next time.
+  std::string AppendMemberPage(const ChannelMember& member,
+                               int after,
+                               std::string* response) const;
 
  protected:
+  ObjectPool<ChannelMember> member_pool_;
+  // Connected members, in the order they signed in (and so ordered by id).
   Members members_;
+  std::unordered_map<int, ChannelMember*> members_by_id_;
+  size_t member_page_size_;
+  int version_;
+  RateLimits limits_;
+  ChannelStats stats_;
+  // Sign-in rate limiters keyed by remote address.  Buckets that have fully
+  // refilled are dropped in CheckForTimeout.
+  std::map<uint32_t, TokenBucket> sign_in_buckets_;
 };
 
 #endif  // EXAMPLES_PEERCONNECTION_SERVER_PEER_CHANNEL_H_
@@ -0,0 +1,159 @@
+/*
+ *  Copyright 2011 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/server/request_trace.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "examples/headless_peerconnection/server/utils.h"
+#include "rtc_base/checks.h"
+
+static const char kTraceMagic[] = "PCSTRC01";
+static const size_t kTraceMagicLength = sizeof(kTraceMagic) - 1;
+
+// Buffered records are written out once they exceed this size.
+static const size_t kFlushThreshold = 64 * 1024;
+
+static void AppendInt(std::string* out, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i)
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+static bool ReadInt(FILE* file, size_t bytes, uint64_t* value) {
+  unsigned char buffer[8];
+  RTC_DCHECK_LE(bytes, sizeof(buffer));
+  if (fread(buffer, 1, bytes, file) != bytes)
+    return false;
+  *value = 0;
+  for (size_t i = 0; i < bytes; ++i)
+    *value |= static_cast<uint64_t>(buffer[i]) << (8 * i);
+  return true;
+}
+
+static bool ReadString(FILE* file, size_t length, std::string* value) {
+  value->resize(length);
+  return length == 0 || fread(&(*value)[0], 1, length, file) == length;
+}
+
+const char* TraceMethodName(uint8_t method) {
+  // Matches DataSocket::RequestMethod.
+  static const char* kMethodNames[] = {NULL, "GET", "POST", "OPTIONS"};
+  return method < ARRAYSIZE(kMethodNames) ? kMethodNames[method] : NULL;
+}
+
+//
+// RequestTraceWriter
+//
+
+RequestTraceWriter::RequestTraceWriter() : file_(NULL) {}
+
+RequestTraceWriter::~RequestTraceWriter() {
+  Close();
+}
+
+bool RequestTraceWriter::Open(const std::string& path) {
+  RTC_DCHECK(!is_open());
+  file_ = fopen(path.c_str(), "wb");
+  if (!file_)
+    return false;
+  start_ = std::chrono::steady_clock::now();
+  buffer_.reserve(2 * kFlushThreshold);
+  buffer_.assign(kTraceMagic, kTraceMagicLength);
+  return true;
+}
+
+void RequestTraceWriter::Write(uint32_t connection_id,
+                               int32_t peer_id,
+                               uint8_t method,
+                               const std::string& path,
+                               const std::string& body) {
+  if (!is_open())
+    return;
+
+  std::chrono::microseconds elapsed =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start_);
+  size_t path_length = std::min<size_t>(path.length(), 0xffff);
+
+  AppendInt(&buffer_, elapsed.count(), 8);
+  AppendInt(&buffer_, connection_id, 4);
+  AppendInt(&buffer_, static_cast<uint32_t>(peer_id), 4);
+  AppendInt(&buffer_, method, 1);
+  AppendInt(&buffer_, path_length, 2);
+  buffer_.append(path, 0, path_length);
+  AppendInt(&buffer_, body.length(), 4);
+  buffer_.append(body);
+
+  if (buffer_.length() >= kFlushThreshold)
+    Flush();
+}
+
+void RequestTraceWriter::Flush() {
+  if (!is_open() || buffer_.empty())
+    return;
+  if (fwrite(buffer_.data(), 1, buffer_.length(), file_) != buffer_.length())
+    printf("Failed to write request trace\n");
+  fflush(file_);
+  buffer_.clear();
+}
+
+void RequestTraceWriter::Close() {
+  if (!is_open())
+    return;
+  Flush();
+  fclose(file_);
+  file_ = NULL;
+}
+
+//
+// RequestTraceReader
+//
+
+RequestTraceReader::RequestTraceReader() : file_(NULL) {}
+
+RequestTraceReader::~RequestTraceReader() {
+  if (file_)
+    fclose(file_);
+}
+
+bool RequestTraceReader::Open(const std::string& path) {
+  RTC_DCHECK(!file_);
+  file_ = fopen(path.c_str(), "rb");
+  if (!file_)
+    return false;
+  char magic[kTraceMagicLength];
+  return fread(magic, 1, sizeof(magic), file_) == sizeof(magic) &&
+         memcmp(magic, kTraceMagic, sizeof(magic)) == 0;
+}
+
+bool RequestTraceReader::Read(TraceRecord* record) {
+  RTC_DCHECK(record);
+  if (!file_)
+    return false;
+
+  uint64_t timestamp_us, connection_id, peer_id, method, path_length,
+      body_length;
+  if (!ReadInt(file_, 8, &timestamp_us) ||
+      !ReadInt(file_, 4, &connection_id) || !ReadInt(file_, 4, &peer_id) ||
+      !ReadInt(file_, 1, &method) || !ReadInt(file_, 2, &path_length) ||
+      !ReadString(file_, path_length, &record->path) ||
+      !ReadInt(file_, 4, &body_length) ||
+      !ReadString(file_, body_length, &record->body)) {
+    return false;
+  }
+
+  record->timestamp_us = timestamp_us;
+  record->connection_id = static_cast<uint32_t>(connection_id);
+  record->peer_id = static_cast<int32_t>(static_cast<uint32_t>(peer_id));
+  record->method = static_cast<uint8_t>(method);
+  return true;
+}
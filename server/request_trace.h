@@ -0,0 +1,92 @@
+/*
+ *  Copyright 2011 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_SERVER_REQUEST_TRACE_H_
+#define EXAMPLES_PEERCONNECTION_SERVER_REQUEST_TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+
+// A request trace is the 8 byte magic "PCSTRC01" followed by one record per
+// request.  All integers are little-endian.
+//
+//   uint64  timestamp_us    Microseconds since the capture started.
+//   uint32  connection_id   DataSocket::id() of the connection.
+//   int32   peer_id         Id the server assigned for a /sign_in request,
+//                           -1 for all other requests.
+//   uint8   method          DataSocket::RequestMethod.
+//   uint16  path_length     Followed by the path, including arguments.
+//   uint32  body_length     Followed by the body.
+struct TraceRecord {
+  uint64_t timestamp_us = 0;
+  uint32_t connection_id = 0;
+  int32_t peer_id = -1;
+  uint8_t method = 0;
+  std::string path;
+  std::string body;
+};
+
+// Returns "GET", "POST" or "OPTIONS" for a record's method, or NULL.
+const char* TraceMethodName(uint8_t method);
+
+// Appends records to a trace file.  Records are collected in memory and
+// written out in large chunks so that capturing doesn't add a system call
+// to every request.
+class RequestTraceWriter {
+ public:
+  RequestTraceWriter();
+  RequestTraceWriter(const RequestTraceWriter&) = delete;
+  RequestTraceWriter& operator=(const RequestTraceWriter&) = delete;
+  ~RequestTraceWriter();
+
+  bool is_open() const { return file_ != NULL; }
+
+  bool Open(const std::string& path);
+
+  // Stamps the record with the time elapsed since Open() and buffers it.
+  void Write(uint32_t connection_id,
+             int32_t peer_id,
+             uint8_t method,
+             const std::string& path,
+             const std::string& body);
+
+  // Writes out everything buffered so far.
+  void Flush();
+
+  void Close();
+
+ private:
+  FILE* file_;
+  std::string buffer_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+class RequestTraceReader {
+ public:
+  RequestTraceReader();
+  RequestTraceReader(const RequestTraceReader&) = delete;
+  RequestTraceReader& operator=(const RequestTraceReader&) = delete;
+  ~RequestTraceReader();
+
+  // Opens the trace and checks its magic.
+  bool Open(const std::string& path);
+
+  // Reads the next record.  Returns false at the end of the trace or if the
+  // trace is truncated.
+  bool Read(TraceRecord* record);
+
+ private:
+  FILE* file_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_SERVER_REQUEST_TRACE_H_
@@ -0,0 +1,50 @@
+/*
+ *  Copyright 2011 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "examples/headless_peerconnection/server/token_bucket.h"
+
+#include <algorithm>
+
+#include "rtc_base/checks.h"
+
+TokenBucket::TokenBucket(double rate, double burst)
+    : rate_(rate),
+      burst_(std::max(burst, 1.0)),
+      tokens_(burst_),
+      last_refill_(std::chrono::steady_clock::now()) {
+  RTC_DCHECK_GE(rate, 0);
+}
+
+bool TokenBucket::TryConsume() {
+  if (!enabled())
+    return true;
+
+  Refill();
+  if (tokens_ < 1)
+    return false;
+
+  tokens_ -= 1;
+  return true;
+}
+
+bool TokenBucket::IsFull() {
+  if (!enabled())
+    return true;
+
+  Refill();
+  return tokens_ >= burst_;
+}
+
+void TokenBucket::Refill() {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed = now - last_refill_;
+  last_refill_ = now;
+  tokens_ = std::min(burst_, tokens_ + elapsed.count() * rate_);
+}
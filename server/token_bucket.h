@@ -0,0 +1,41 @@
+/*
+ *  Copyright 2011 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef EXAMPLES_PEERCONNECTION_SERVER_TOKEN_BUCKET_H_
+#define EXAMPLES_PEERCONNECTION_SERVER_TOKEN_BUCKET_H_
+
+#include <chrono>
+
+// Refills at `rate` tokens per second, holding at most `burst` tokens.
+// A bucket with a rate of zero never runs dry.
+class TokenBucket {
+ public:
+  TokenBucket() : TokenBucket(0, 0) {}
+  TokenBucket(double rate, double burst);
+
+  bool enabled() const { return rate_ > 0; }
+
+  // Takes a token if one is available.
+  bool TryConsume();
+
+  // Returns true if the bucket has refilled completely, i.e. it no longer
+  // remembers anything about past requests and can be discarded.
+  bool IsFull();
+
+ private:
+  void Refill();
+
+  double rate_;
+  double burst_;
+  double tokens_;
+  std::chrono::steady_clock::time_point last_refill_;
+};
+
+#endif  // EXAMPLES_PEERCONNECTION_SERVER_TOKEN_BUCKET_H_
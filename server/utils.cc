@@ -8,7 +8,7 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 
-#include "examples/peerconnection/server/utils.h"
+#include "examples/headless_peerconnection/server/utils.h"
 
 #include <stdio.h>
 